@@ -0,0 +1,84 @@
+#include "bounds.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+Bounds makeBounds(const glm::vec3* points, size_t count, size_t stride) {
+  Bounds bounds;
+  if (count == 0) {
+    return bounds;
+  }
+
+  const char* bytes = (const char*)points;
+  for (size_t i = 0; i < count; i++) {
+    const glm::vec3& point = *(const glm::vec3*)(bytes + i * stride);
+    bounds.min = glm::min(bounds.min, point);
+    bounds.max = glm::max(bounds.max, point);
+  }
+
+  bounds.center = (bounds.min + bounds.max) * 0.5f;
+  float radiusSq = 0.0f;
+  for (size_t i = 0; i < count; i++) {
+    const glm::vec3& point = *(const glm::vec3*)(bytes + i * stride);
+    glm::vec3 offset = point - bounds.center;
+    radiusSq = std::max(radiusSq, glm::dot(offset, offset));
+  }
+  bounds.radius = std::sqrt(radiusSq);
+  return bounds;
+}
+
+Bounds mergeBounds(const Bounds& a, const Bounds& b) {
+  if (a.isEmpty()) {
+    return b;
+  }
+  if (b.isEmpty()) {
+    return a;
+  }
+
+  Bounds bounds;
+  bounds.min = glm::min(a.min, b.min);
+  bounds.max = glm::max(a.max, b.max);
+
+  // smallest sphere enclosing both spheres
+  glm::vec3 offset = b.center - a.center;
+  float distance = glm::length(offset);
+  if (distance + b.radius <= a.radius) {
+    bounds.center = a.center;
+    bounds.radius = a.radius;
+  } else if (distance + a.radius <= b.radius) {
+    bounds.center = b.center;
+    bounds.radius = b.radius;
+  } else {
+    bounds.radius = (distance + a.radius + b.radius) * 0.5f;
+    bounds.center = a.center + offset * ((bounds.radius - a.radius) / distance);
+  }
+  return bounds;
+}
+
+Bounds transformBounds(const Bounds& bounds, const glm::mat4& transform) {
+  if (bounds.isEmpty()) {
+    return bounds;
+  }
+
+  // Arvo: each output axis takes the min/max of every matrix column times
+  // the input extents
+  Bounds result;
+  glm::vec3 translation(transform[3]);
+  result.min = translation;
+  result.max = translation;
+  for (int i = 0; i < 3; i++) {
+    glm::vec3 column(transform[i]);
+    glm::vec3 a = column * bounds.min[i];
+    glm::vec3 b = column * bounds.max[i];
+    result.min += glm::min(a, b);
+    result.max += glm::max(a, b);
+  }
+
+  float scaleSq = std::max(
+      glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+      std::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+               glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))));
+  result.center = glm::vec3(transform * glm::vec4(bounds.center, 1.0f));
+  result.radius = bounds.radius * std::sqrt(scaleSq);
+  return result;
+}
@@ -0,0 +1,52 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <limits>
+
+/**
+ * @brief Axis aligned bounding box together with a bounding sphere.
+ *
+ * A default constructed Bounds is empty (min > max, negative radius).
+ */
+struct Bounds {
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+  glm::vec3 center = glm::vec3(0.0f);
+  float radius = -1.0f;
+
+  bool isEmpty() const { return min.x > max.x; }
+};
+
+/**
+ * @brief Computes the bounds of a set of points
+ *
+ * @param points first point
+ * @param count number of points
+ * @param stride bytes between two consecutive points
+ * @return Bounds sphere centered on the box, enclosing all points
+ */
+Bounds makeBounds(const glm::vec3* points, size_t count, size_t stride);
+
+/**
+ * @brief Computes bounds enclosing both `a` and `b`
+ *
+ * @param a
+ * @param b
+ * @return Bounds
+ */
+Bounds mergeBounds(const Bounds& a, const Bounds& b);
+
+/**
+ * @brief Transforms bounds into another space. The box stays axis aligned
+ * and encloses the transformed box, the sphere is scaled by the largest
+ * axis scale of `transform`.
+ *
+ * @param bounds
+ * @param transform
+ * @return Bounds
+ */
+Bounds transformBounds(const Bounds& bounds, const glm::mat4& transform);
+
+#endif
@@ -4,7 +4,9 @@ Camera::Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch)
     : Front(glm::vec3(0.0f, 0.0f, -1.0f)),
       MovementSpeed(SPEED),
       MouseSensitivity(SENSITIVITY),
-      Fov(FOV) {
+      Fov(FOV),
+      Near(NEAR_PLANE),
+      Far(FAR_PLANE) {
   Position = position;
   WorldUp = up;
   Yaw = yaw;
@@ -23,7 +25,9 @@ Camera::Camera(float posX,
     : Front(glm::vec3(0.0f, 0.0f, -1.0f)),
       MovementSpeed(SPEED),
       MouseSensitivity(SENSITIVITY),
-      Fov(FOV) {
+      Fov(FOV),
+      Near(NEAR_PLANE),
+      Far(FAR_PLANE) {
   Position = glm::vec3(posX, posY, posZ);
   WorldUp = glm::vec3(upX, upY, upZ);
   Yaw = yaw;
@@ -35,6 +39,10 @@ glm::mat4 Camera::getViewMatrix() {
   return glm::lookAt(Position, Position + Front, Up);
 }
 
+glm::mat4 Camera::getProjectionMatrix(float aspect) const {
+  return glm::perspective(glm::radians(Fov), aspect, Near, Far);
+}
+
 void Camera::processKeyboard(Camera_Movement direction, float deltaTime) {
   float velocity = MovementSpeed * deltaTime;
 
@@ -21,6 +21,10 @@ const float SPEED = 2.5f;
 const float SENSITIVITY = 0.1f;
 // Default camera FOV
 const float FOV = 45.0f;
+// Default near clipping plane distance
+const float NEAR_PLANE = 0.1f;
+// Default far clipping plane distance
+const float FAR_PLANE = 100.0f;
 
 // An abstract camera class that processes input and calculates the
 // corresponding Euler Angles, Vectors and Matrices for use in OpenGL
@@ -39,6 +43,8 @@ class Camera {
   float MovementSpeed;
   float MouseSensitivity;
   float Fov;
+  float Near;
+  float Far;
 
   /**
    * @brief Constructs a Camera object with optional initial position, up
@@ -87,6 +93,15 @@ class Camera {
    */
   glm::mat4 getViewMatrix();
 
+  /**
+   * @brief Returns the perspective projection matrix for the current FOV and
+   * clipping planes.
+   *
+   * @param aspect Viewport width divided by height.
+   * @return glm::mat4 The projection matrix.
+   */
+  glm::mat4 getProjectionMatrix(float aspect) const;
+
   /**
    * @brief Processes keyboard input to move the camera position.
    *
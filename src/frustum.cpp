@@ -0,0 +1,153 @@
+#include "frustum.hpp"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define FRUSTUM_USE_SSE
+#endif
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+  // rows of the matrix (glm is column major)
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++) {
+    rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                        viewProjection[2][i], viewProjection[3][i]);
+  }
+
+  planes_[0] = rows[3] + rows[0];  // left
+  planes_[1] = rows[3] - rows[0];  // right
+  planes_[2] = rows[3] + rows[1];  // bottom
+  planes_[3] = rows[3] - rows[1];  // top
+  planes_[4] = rows[3] + rows[2];  // near
+  planes_[5] = rows[3] - rows[2];  // far
+
+  for (glm::vec4& plane : planes_) {
+    float length = glm::length(glm::vec3(plane));
+    plane = plane / length;
+  }
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+  for (const glm::vec4& plane : planes_) {
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Frustum::intersectsBox(const glm::vec3& min, const glm::vec3& max) const {
+  for (const glm::vec4& plane : planes_) {
+    // corner furthest along the plane normal
+    glm::vec3 positive(plane.x >= 0.0f ? max.x : min.x,
+                       plane.y >= 0.0f ? max.y : min.y,
+                       plane.z >= 0.0f ? max.z : min.z);
+    if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+FrustumResult Frustum::classifyBox(const glm::vec3& min,
+                                  const glm::vec3& max) const {
+  FrustumResult result = FRUSTUM_INSIDE;
+  for (const glm::vec4& plane : planes_) {
+    glm::vec3 normal(plane);
+    // corners furthest along and against the plane normal
+    glm::vec3 positive(plane.x >= 0.0f ? max.x : min.x,
+                       plane.y >= 0.0f ? max.y : min.y,
+                       plane.z >= 0.0f ? max.z : min.z);
+    glm::vec3 negative(plane.x >= 0.0f ? min.x : max.x,
+                       plane.y >= 0.0f ? min.y : max.y,
+                       plane.z >= 0.0f ? min.z : max.z);
+    if (glm::dot(normal, positive) + plane.w < 0.0f) {
+      return FRUSTUM_OUTSIDE;
+    }
+    if (glm::dot(normal, negative) + plane.w < 0.0f) {
+      result = FRUSTUM_INTERSECTS;
+    }
+  }
+  return result;
+}
+
+size_t Frustum::cullSpheres(const float* x,
+                            const float* y,
+                            const float* z,
+                            const float* radius,
+                            size_t count,
+                            uint8_t* visible) const {
+  size_t visibleCount = 0;
+  size_t i = 0;
+
+#ifdef FRUSTUM_USE_SSE
+  __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+  for (int p = 0; p < 6; p++) {
+    planeX[p] = _mm_set1_ps(planes_[p].x);
+    planeY[p] = _mm_set1_ps(planes_[p].y);
+    planeZ[p] = _mm_set1_ps(planes_[p].z);
+    planeW[p] = _mm_set1_ps(planes_[p].w);
+  }
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 cx = _mm_loadu_ps(x + i);
+    __m128 cy = _mm_loadu_ps(y + i);
+    __m128 cz = _mm_loadu_ps(z + i);
+    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+    __m128 inside = _mm_setzero_ps();
+    for (int p = 0; p < 6; p++) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+          _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+      __m128 insidePlane = _mm_cmpge_ps(distance, negRadius);
+      inside = p == 0 ? insidePlane : _mm_and_ps(inside, insidePlane);
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    for (int lane = 0; lane < 4; lane++) {
+      visible[i + lane] = (mask >> lane) & 1;
+      visibleCount += visible[i + lane];
+    }
+  }
+#endif
+
+  // remainder, or everything without SSE
+  for (; i < count; i++) {
+    visible[i] = intersectsSphere(glm::vec3(x[i], y[i], z[i]), radius[i]);
+    visibleCount += visible[i];
+  }
+  return visibleCount;
+}
+
+bool Frustum::intersectsCone(const glm::vec3& apex,
+                             const glm::vec3& direction,
+                             float height,
+                             float cosAngle) const {
+  // wide or unbounded cones are not worth the extra math, bound them by
+  // their sphere
+  if (cosAngle < 0.1f || std::isinf(height)) {
+    return intersectsSphere(apex, height);
+  }
+  float tanAngle = std::sqrt(1.0f - cosAngle * cosAngle) / cosAngle;
+  glm::vec3 baseCenter = apex + direction * height;
+  float baseRadius = height * tanAngle;
+
+  for (const glm::vec4& plane : planes_) {
+    glm::vec3 normal(plane);
+    // the cone is the convex hull of its apex and base disc, it is outside
+    // of the plane if both the apex and the disc's lowest point are
+    glm::vec3 rim = normal - direction * glm::dot(normal, direction);
+    float rimLength = glm::length(rim);
+    glm::vec3 lowest = baseCenter;
+    if (rimLength > 1e-6f) {
+      lowest = baseCenter - rim * (baseRadius / rimLength);
+    }
+    if (glm::dot(normal, apex) + plane.w < 0.0f &&
+        glm::dot(normal, lowest) + plane.w < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
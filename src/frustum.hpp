@@ -0,0 +1,101 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// result of `Frustum::classifyBox()`
+enum FrustumResult { FRUSTUM_OUTSIDE, FRUSTUM_INTERSECTS, FRUSTUM_INSIDE };
+
+/**
+ * @brief View frustum as 6 planes, used for culling.
+ *
+ * Each plane is stored as (normal, distance) with the normal pointing into
+ * the frustum, so a point p is inside a plane if dot(normal, p) + distance
+ * >= 0.
+ */
+class Frustum {
+ public:
+  // left, right, bottom, top, near, far
+  glm::vec4 planes_[6];
+
+  Frustum() = default;
+
+  /**
+   * @brief Extracts the world space frustum planes from a combined
+   * projection * view matrix (Gribb/Hartmann)
+   *
+   * @param viewProjection
+   */
+  explicit Frustum(const glm::mat4& viewProjection);
+
+  /**
+   * @brief Check if a sphere is at least partially inside the frustum
+   *
+   * @param center
+   * @param radius
+   * @return true
+   * @return false
+   */
+  bool intersectsSphere(const glm::vec3& center, float radius) const;
+
+  /**
+   * @brief Check if an axis aligned box is at least partially inside the
+   * frustum (conservative near the frustum corners)
+   *
+   * @param min
+   * @param max
+   * @return true
+   * @return false
+   */
+  bool intersectsBox(const glm::vec3& min, const glm::vec3& max) const;
+
+  /**
+   * @brief Classifies an axis aligned box as outside, intersecting or fully
+   * inside the frustum. Used by hierarchical culling to accept whole
+   * subtrees without testing their children.
+   *
+   * @param min
+   * @param max
+   * @return FrustumResult
+   */
+  FrustumResult classifyBox(const glm::vec3& min, const glm::vec3& max) const;
+
+  /**
+   * @brief Tests `count` spheres given as separate coordinate arrays (SoA)
+   * at once, four per iteration with SSE where available
+   *
+   * @param x sphere centers
+   * @param y
+   * @param z
+   * @param radius
+   * @param count
+   * @param visible set to 1 for spheres intersecting the frustum, else 0
+   * @return size_t number of visible spheres
+   */
+  size_t cullSpheres(const float* x,
+                     const float* y,
+                     const float* z,
+                     const float* radius,
+                     size_t count,
+                     uint8_t* visible) const;
+
+  /**
+   * @brief Check if a cone is at least partially inside the frustum
+   * (conservative, may report cones just outside a frustum corner)
+   *
+   * @param apex
+   * @param direction normalized cone axis
+   * @param height length of the cone along its axis
+   * @param cosAngle cosine of the half opening angle
+   * @return true
+   * @return false
+   */
+  bool intersectsCone(const glm::vec3& apex,
+                      const glm::vec3& direction,
+                      float height,
+                      float cosAngle) const;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "gl_state.hpp"
+
+unsigned int GlState::program_ = ~0u;
+unsigned int GlState::vertexArray_ = ~0u;
+unsigned int GlState::activeTexture_ = ~0u;
+unsigned int GlState::textures_[GL_STATE_TEXTURE_UNITS];
+unsigned int GlState::buffers_[BUFFER_TARGET_COUNT];
+int GlState::capabilities_[CAP_COUNT];
+GlStateStats GlState::stats_;
+
+int GlState::getBufferTarget(GLenum target) {
+  switch (target) {
+    case GL_ARRAY_BUFFER:
+      return BUFFER_ARRAY;
+    case GL_COPY_READ_BUFFER:
+      return BUFFER_COPY_READ;
+    case GL_COPY_WRITE_BUFFER:
+      return BUFFER_COPY_WRITE;
+    case GL_DRAW_INDIRECT_BUFFER:
+      return BUFFER_DRAW_INDIRECT;
+    case GL_SHADER_STORAGE_BUFFER:
+      return BUFFER_SHADER_STORAGE;
+    case GL_UNIFORM_BUFFER:
+      return BUFFER_UNIFORM;
+  }
+  return -1;
+}
+
+int GlState::getCapability(GLenum capability) {
+  switch (capability) {
+    case GL_DEPTH_TEST:
+      return CAP_DEPTH_TEST;
+    case GL_BLEND:
+      return CAP_BLEND;
+    case GL_CULL_FACE:
+      return CAP_CULL_FACE;
+  }
+  return -1;
+}
+
+bool GlState::change(unsigned int& cached, unsigned int value) {
+  if (cached == value) {
+    stats_.skipped++;
+    return false;
+  }
+  cached = value;
+  stats_.calls++;
+  return true;
+}
+
+void GlState::useProgram(unsigned int program) {
+  if (change(program_, program)) {
+    glUseProgram(program);
+  }
+}
+
+void GlState::bindVertexArray(unsigned int vertexArray) {
+  if (change(vertexArray_, vertexArray)) {
+    glBindVertexArray(vertexArray);
+  }
+}
+
+void GlState::bindTexture(unsigned int unit,
+                          unsigned int texture,
+                          GLenum target) {
+  if (unit >= GL_STATE_TEXTURE_UNITS) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(target, texture);
+    activeTexture_ = unit;
+    stats_.calls += 2;
+    return;
+  }
+  if (textures_[unit] == texture) {
+    stats_.skipped++;
+    return;
+  }
+  if (change(activeTexture_, unit)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+  change(textures_[unit], texture);
+  glBindTexture(target, texture);
+}
+
+void GlState::bindBuffer(GLenum target, unsigned int buffer) {
+  int index = getBufferTarget(target);
+  if (index < 0) {
+    glBindBuffer(target, buffer);
+    stats_.calls++;
+    return;
+  }
+  if (change(buffers_[index], buffer)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void GlState::bindBufferBase(GLenum target,
+                             unsigned int index,
+                             unsigned int buffer) {
+  glBindBufferBase(target, index, buffer);
+  stats_.calls++;
+  int cached = getBufferTarget(target);
+  if (cached >= 0) {
+    buffers_[cached] = buffer;
+  }
+}
+
+void GlState::bindBufferRange(GLenum target,
+                              unsigned int index,
+                              unsigned int buffer,
+                              GLintptr offset,
+                              GLsizeiptr size) {
+  glBindBufferRange(target, index, buffer, offset, size);
+  stats_.calls++;
+  int cached = getBufferTarget(target);
+  if (cached >= 0) {
+    buffers_[cached] = buffer;
+  }
+}
+
+void GlState::setEnabled(GLenum capability, bool enabled) {
+  int index = getCapability(capability);
+  if (index >= 0 && capabilities_[index] == (int)enabled) {
+    stats_.skipped++;
+    return;
+  }
+  if (index >= 0) {
+    capabilities_[index] = enabled;
+  }
+  if (enabled) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+  stats_.calls++;
+}
+
+void GlState::deleteProgram(unsigned int program) {
+  glDeleteProgram(program);
+  // a deleted program stays in use until another one is installed, but its
+  // name may be reused
+  if (program_ == program) {
+    program_ = ~0u;
+  }
+}
+
+void GlState::deleteVertexArray(unsigned int vertexArray) {
+  glDeleteVertexArrays(1, &vertexArray);
+  if (vertexArray_ == vertexArray) {
+    vertexArray_ = 0;
+  }
+}
+
+void GlState::deleteBuffer(unsigned int buffer) {
+  glDeleteBuffers(1, &buffer);
+  for (unsigned int& bound : buffers_) {
+    if (bound == buffer) {
+      bound = 0;
+    }
+  }
+}
+
+void GlState::deleteTexture(unsigned int texture) {
+  glDeleteTextures(1, &texture);
+  for (unsigned int& bound : textures_) {
+    if (bound == texture) {
+      bound = 0;
+    }
+  }
+}
+
+void GlState::invalidate() {
+  program_ = ~0u;
+  vertexArray_ = ~0u;
+  activeTexture_ = ~0u;
+  for (unsigned int& texture : textures_) {
+    texture = ~0u;
+  }
+  for (unsigned int& buffer : buffers_) {
+    buffer = ~0u;
+  }
+  for (int& capability : capabilities_) {
+    capability = -1;
+  }
+}
@@ -0,0 +1,164 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// texture units tracked by `GlState`, higher units are passed through
+constexpr unsigned int GL_STATE_TEXTURE_UNITS = 32;
+
+/**
+ * @brief Counters for state changes sent through `GlState`.
+ *
+ * Use `GlState::resetStats()` at the start of a frame to measure it.
+ */
+struct GlStateStats {
+  // state changes that reached the driver
+  unsigned int calls = 0;
+  // state changes filtered out because the state was already set
+  unsigned int skipped = 0;
+};
+
+/**
+ * @brief Shadow copy of the bound OpenGL state, filters out redundant
+ * binds.
+ *
+ * Tracks the program, vertex array, texture per unit, the buffer bound
+ * to the generic (non indexed) buffer targets and the depth test, blending
+ * and face culling switches. All code must change this state through
+ * `GlState`, otherwise the shadow copy goes stale; call `invalidate()` once
+ * the context is created and after code that bypasses it. Objects must be
+ * deleted through `GlState` as well, since OpenGL unbinds deleted objects.
+ *
+ * The element array buffer binding is part of the vertex array object and
+ * is not cached.
+ */
+class GlState {
+ public:
+  static void useProgram(unsigned int program);
+  static void bindVertexArray(unsigned int vertexArray);
+
+  /**
+   * @brief Binds a texture to `unit`, switching the active texture unit
+   * only if the binding changes. The active unit is left at `unit`.
+   *
+   * Only one texture is tracked per unit, use separate units for textures
+   * of different targets.
+   *
+   * @param unit index, not `GL_TEXTURE0 + index`
+   * @param texture
+   * @param target
+   */
+  static void bindTexture(unsigned int unit,
+                          unsigned int texture,
+                          GLenum target = GL_TEXTURE_2D);
+
+  /**
+   * @brief Binds `buffer` to a generic buffer target such as
+   * `GL_ARRAY_BUFFER` or `GL_SHADER_STORAGE_BUFFER`
+   *
+   * @param target
+   * @param buffer
+   */
+  static void bindBuffer(GLenum target, unsigned int buffer);
+
+  /**
+   * @brief Binds `buffer` to an indexed binding point. This also binds it to
+   * the generic `target`, so the cached binding is updated.
+   *
+   * @param target
+   * @param index
+   * @param buffer
+   */
+  static void bindBufferBase(GLenum target,
+                             unsigned int index,
+                             unsigned int buffer);
+
+  /**
+   * @brief Binds a range of `buffer` to an indexed binding point, updating
+   * the cached generic binding like `bindBufferBase()`
+   *
+   * @param target
+   * @param index
+   * @param buffer
+   * @param offset in bytes, aligned to the target's offset alignment
+   * @param size in bytes
+   */
+  static void bindBufferRange(GLenum target,
+                              unsigned int index,
+                              unsigned int buffer,
+                              GLintptr offset,
+                              GLsizeiptr size);
+
+  /**
+   * @brief Enables or disables `GL_DEPTH_TEST`, `GL_BLEND` or
+   * `GL_CULL_FACE`, other capabilities are passed through
+   *
+   * @param capability
+   * @param enabled
+   */
+  static void setEnabled(GLenum capability, bool enabled);
+
+  static void deleteProgram(unsigned int program);
+  static void deleteVertexArray(unsigned int vertexArray);
+  static void deleteBuffer(unsigned int buffer);
+  static void deleteTexture(unsigned int texture);
+
+  /**
+   * @brief Forgets the tracked state, the next change of each state is
+   * sent to the driver
+   *
+   */
+  static void invalidate();
+
+  /**
+   * @brief Get the counters shared by all state changes
+   *
+   * @return const GlStateStats&
+   */
+  static const GlStateStats& stats() { return stats_; }
+
+  /**
+   * @brief Reset the counters, e.g. at the start of a frame
+   *
+   */
+  static void resetStats() { stats_ = GlStateStats(); }
+
+ private:
+  // generic buffer targets with a cached binding
+  enum BufferTarget {
+    BUFFER_ARRAY,
+    BUFFER_COPY_READ,
+    BUFFER_COPY_WRITE,
+    BUFFER_DRAW_INDIRECT,
+    BUFFER_SHADER_STORAGE,
+    BUFFER_UNIFORM,
+    BUFFER_TARGET_COUNT
+  };
+
+  enum Capability { CAP_DEPTH_TEST, CAP_BLEND, CAP_CULL_FACE, CAP_COUNT };
+
+  // ~0u (or -1 for capabilities) means unknown, the next change is sent
+  static unsigned int program_;
+  static unsigned int vertexArray_;
+  static unsigned int activeTexture_;
+  static unsigned int textures_[GL_STATE_TEXTURE_UNITS];
+  static unsigned int buffers_[BUFFER_TARGET_COUNT];
+  static int capabilities_[CAP_COUNT];
+
+  static GlStateStats stats_;
+
+  /**
+   * @brief Updates a cached value, counting the call or the skip
+   *
+   * @param cached
+   * @param value
+   * @return true if the value changed and has to be sent to the driver
+   */
+  static bool change(unsigned int& cached, unsigned int value);
+
+  // index into `buffers_` / `capabilities_`, -1 if not tracked
+  static int getBufferTarget(GLenum target);
+  static int getCapability(GLenum capability);
+};
+
+#endif
@@ -0,0 +1,286 @@
+#include "lightclusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "gl_state.hpp"
+
+// invocations per compute work group, see cClusterLights.glsl
+static const unsigned int CLUSTER_WORK_GROUP_SIZE = 64;
+
+static unsigned int getClusterIndex(unsigned int x,
+                                    unsigned int y,
+                                    unsigned int z) {
+  return x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * z);
+}
+
+static bool sphereIntersectsBounds(const glm::vec3& center,
+                                   float radius,
+                                   const glm::vec4& min,
+                                   const glm::vec4& max) {
+  glm::vec3 closest(std::max(min.x, std::min(center.x, max.x)),
+                    std::max(min.y, std::min(center.y, max.y)),
+                    std::max(min.z, std::min(center.z, max.z)));
+  glm::vec3 delta = closest - center;
+  return glm::dot(delta, delta) <= radius * radius;
+}
+
+// threads used by the CPU assignment, including the calling one
+static unsigned int getAssignThreadCount() {
+  return std::min(std::max(std::thread::hardware_concurrency(), 1u),
+                  CLUSTER_GRID_Z);
+}
+
+LightClusters::LightClusters() : workers_(getAssignThreadCount() - 1) {
+  useCompute_ = false;
+  boundsFov_ = boundsAspect_ = boundsNear_ = boundsFar_ = 0.0f;
+  referenceCount_ = 0;
+  lightIndicesCapacity_ = 0;
+  bounds_.resize(CLUSTER_COUNT);
+  clusterLights_.resize(CLUSTER_COUNT);
+  grid_.resize(CLUSTER_COUNT * 2);
+
+  glCreateBuffers(1, &lightGridSSBO_);
+  glNamedBufferStorage(
+      lightGridSSBO_, sizeof(GridHeader) + CLUSTER_COUNT * 2 * sizeof(uint32_t),
+      nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+  glCreateBuffers(1, &clusterBoundsSSBO_);
+  glNamedBufferStorage(clusterBoundsSSBO_,
+                       CLUSTER_COUNT * sizeof(ClusterBounds), nullptr,
+                       GL_DYNAMIC_STORAGE_BIT);
+
+  // created and bound by reserveIndices()
+  lightIndicesSSBO_ = 0;
+  reserveIndices(CLUSTER_COUNT);
+
+  GlState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_GRID_SSBO_BINDING,
+                          lightGridSSBO_);
+  GlState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BOUNDS_SSBO_BINDING,
+                          clusterBoundsSSBO_);
+}
+
+void LightClusters::update(const Camera& camera,
+                           const glm::mat4& view,
+                           unsigned int width,
+                           unsigned int height,
+                           const LightManager& lights) {
+  updateBounds(camera, (float)width / (float)height);
+
+  // depth slice of view depth d: log(d) * scale - bias
+  float logDepthRange = std::log(camera.Far / camera.Near);
+  GridHeader header = {
+      {CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, 0},
+      {(float)width, (float)height, CLUSTER_GRID_Z / logDepthRange,
+       CLUSTER_GRID_Z * std::log(camera.Near) / logDepthRange}};
+  glNamedBufferSubData(lightGridSSBO_, 0, sizeof(header), &header);
+
+  if (useCompute_) {
+    assignOnGpu();
+  } else {
+    assignOnCpu(view, lights);
+  }
+}
+
+void LightClusters::updateBounds(const Camera& camera, float aspect) {
+  if (camera.Fov == boundsFov_ && aspect == boundsAspect_ &&
+      camera.Near == boundsNear_ && camera.Far == boundsFar_) {
+    return;
+  }
+  boundsFov_ = camera.Fov;
+  boundsAspect_ = aspect;
+  boundsNear_ = camera.Near;
+  boundsFar_ = camera.Far;
+
+  float tanHalfFov = std::tan(glm::radians(camera.Fov) * 0.5f);
+  for (unsigned int z = 0; z < CLUSTER_GRID_Z; z++) {
+    // exponential slices, thin close to the camera
+    float sliceNear = camera.Near * std::pow(camera.Far / camera.Near,
+                                             (float)z / CLUSTER_GRID_Z);
+    float sliceFar = camera.Near * std::pow(camera.Far / camera.Near,
+                                            (float)(z + 1) / CLUSTER_GRID_Z);
+    for (unsigned int y = 0; y < CLUSTER_GRID_Y; y++) {
+      float ndcY0 = -1.0f + 2.0f * y / CLUSTER_GRID_Y;
+      float ndcY1 = -1.0f + 2.0f * (y + 1) / CLUSTER_GRID_Y;
+      for (unsigned int x = 0; x < CLUSTER_GRID_X; x++) {
+        float ndcX0 = -1.0f + 2.0f * x / CLUSTER_GRID_X;
+        float ndcX1 = -1.0f + 2.0f * (x + 1) / CLUSTER_GRID_X;
+
+        // the tile edges scale linearly with depth, so the extremes are at
+        // the near or far end of the slice
+        float scaleX = tanHalfFov * aspect;
+        float xs[4] = {ndcX0 * scaleX * sliceNear, ndcX1 * scaleX * sliceNear,
+                       ndcX0 * scaleX * sliceFar, ndcX1 * scaleX * sliceFar};
+        float ys[4] = {ndcY0 * tanHalfFov * sliceNear,
+                       ndcY1 * tanHalfFov * sliceNear,
+                       ndcY0 * tanHalfFov * sliceFar,
+                       ndcY1 * tanHalfFov * sliceFar};
+
+        ClusterBounds& bounds = bounds_[getClusterIndex(x, y, z)];
+        bounds.min = glm::vec4(*std::min_element(xs, xs + 4),
+                               *std::min_element(ys, ys + 4), -sliceFar, 0.0f);
+        bounds.max = glm::vec4(*std::max_element(xs, xs + 4),
+                               *std::max_element(ys, ys + 4), -sliceNear,
+                               0.0f);
+      }
+    }
+  }
+
+  glNamedBufferSubData(clusterBoundsSSBO_, 0,
+                       bounds_.size() * sizeof(ClusterBounds), bounds_.data());
+}
+
+void LightClusters::assignOnCpu(const glm::mat4& view,
+                                const LightManager& lights) {
+  // indices refer to the active lights, in the order they were uploaded
+  spheres_.clear();
+  const std::vector<PointLight>& pointLights = lights.getPointLights();
+  const std::vector<unsigned int>& activePoints = lights.getActivePointLights();
+  for (uint32_t i = 0; i < activePoints.size(); i++) {
+    const PointLight& light = pointLights[activePoints[i]];
+    glm::vec3 center(view * glm::vec4(light.position, 1.0f));
+    spheres_.push_back(
+        {center, lights.getPointLightRadius(activePoints[i]), i});
+  }
+  const std::vector<SpotLight>& spotLights = lights.getSpotLights();
+  const std::vector<unsigned int>& activeSpots = lights.getActiveSpotLights();
+  for (uint32_t i = 0; i < activeSpots.size(); i++) {
+    // the sphere around the spot light's position bounds its cone
+    const SpotLight& light = spotLights[activeSpots[i]];
+    glm::vec3 center(view * glm::vec4(light.position, 1.0f));
+    spheres_.push_back({center, lights.getSpotLightRadius(activeSpots[i]),
+                        i | SPOT_LIGHT_INDEX_BIT});
+  }
+
+  for (auto& clusterLights : clusterLights_) {
+    clusterLights.clear();
+  }
+
+  // parts own disjoint depth slices, so no synchronization is needed
+  unsigned int partCount =
+      spheres_.size() < 64 ? 1 : workers_.getThreadCount();
+  workers_.run(partCount, [this, partCount](unsigned int part) {
+    assignSlices(part * CLUSTER_GRID_Z / partCount,
+                 (part + 1) * CLUSTER_GRID_Z / partCount);
+  });
+
+  // flatten into (offset, count) per cluster and one index list
+  indices_.clear();
+  for (unsigned int i = 0; i < CLUSTER_COUNT; i++) {
+    grid_[2 * i] = indices_.size();
+    grid_[2 * i + 1] = clusterLights_[i].size();
+    indices_.insert(indices_.end(), clusterLights_[i].begin(),
+                    clusterLights_[i].end());
+  }
+  referenceCount_ = indices_.size();
+
+  reserveIndices(indices_.size());
+  glNamedBufferSubData(lightGridSSBO_, sizeof(GridHeader),
+                       grid_.size() * sizeof(uint32_t), grid_.data());
+  if (!indices_.empty()) {
+    glNamedBufferSubData(lightIndicesSSBO_, 0,
+                         indices_.size() * sizeof(uint32_t), indices_.data());
+  }
+}
+
+void LightClusters::assignSlices(unsigned int firstSlice,
+                                 unsigned int lastSlice) {
+  float logDepthRange = std::log(boundsFar_ / boundsNear_);
+
+  for (const LightSphere& sphere : spheres_) {
+    // view space looks down -z
+    float depthMin = -sphere.center.z - sphere.radius;
+    float depthMax = -sphere.center.z + sphere.radius;
+    if (depthMax < boundsNear_ || depthMin > boundsFar_) {
+      continue;
+    }
+
+    unsigned int sliceMin = 0;
+    if (depthMin > boundsNear_) {
+      sliceMin = (unsigned int)(CLUSTER_GRID_Z *
+                                std::log(depthMin / boundsNear_) /
+                                logDepthRange);
+    }
+    unsigned int sliceMax = CLUSTER_GRID_Z - 1;
+    if (depthMax < boundsFar_) {
+      sliceMax = std::min(
+          sliceMax, (unsigned int)(CLUSTER_GRID_Z *
+                                   std::log(depthMax / boundsNear_) /
+                                   logDepthRange));
+    }
+    sliceMin = std::max(sliceMin, firstSlice);
+    sliceMax = std::min(sliceMax, lastSlice - 1);
+
+    for (unsigned int z = sliceMin; z <= sliceMax; z++) {
+      // the tile x/y extents grow monotonically with the tile index, narrow
+      // down the candidate tiles before testing the exact bounds
+      unsigned int xMin = 0, xMax = CLUSTER_GRID_X;
+      while (xMin < CLUSTER_GRID_X &&
+             bounds_[getClusterIndex(xMin, 0, z)].max.x <
+                 sphere.center.x - sphere.radius) {
+        xMin++;
+      }
+      while (xMax > xMin && bounds_[getClusterIndex(xMax - 1, 0, z)].min.x >
+                                sphere.center.x + sphere.radius) {
+        xMax--;
+      }
+      unsigned int yMin = 0, yMax = CLUSTER_GRID_Y;
+      while (yMin < CLUSTER_GRID_Y &&
+             bounds_[getClusterIndex(0, yMin, z)].max.y <
+                 sphere.center.y - sphere.radius) {
+        yMin++;
+      }
+      while (yMax > yMin && bounds_[getClusterIndex(0, yMax - 1, z)].min.y >
+                                sphere.center.y + sphere.radius) {
+        yMax--;
+      }
+
+      for (unsigned int y = yMin; y < yMax; y++) {
+        for (unsigned int x = xMin; x < xMax; x++) {
+          unsigned int cluster = getClusterIndex(x, y, z);
+          if (sphereIntersectsBounds(sphere.center, sphere.radius,
+                                     bounds_[cluster].min,
+                                     bounds_[cluster].max)) {
+            clusterLights_[cluster].push_back(sphere.index);
+          }
+        }
+      }
+    }
+  }
+}
+
+void LightClusters::assignOnGpu() {
+  if (!computeShader_) {
+    computeShader_ = std::make_unique<Shader>(
+        "./shaders/cClusterLights.glsl",
+        "#define MAX_LIGHTS_PER_CLUSTER " +
+            std::to_string(MAX_LIGHTS_PER_CLUSTER) + "\n");
+  }
+  // fixed size list per cluster, no compaction needed
+  reserveIndices(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER);
+
+  computeShader_->use();
+  glDispatchCompute(
+      (CLUSTER_COUNT + CLUSTER_WORK_GROUP_SIZE - 1) / CLUSTER_WORK_GROUP_SIZE,
+      1, 1);
+  // make the light lists visible to the fragment shader
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void LightClusters::reserveIndices(size_t count) {
+  if (count <= lightIndicesCapacity_) {
+    return;
+  }
+  lightIndicesCapacity_ = std::max(count, lightIndicesCapacity_ * 2);
+  // immutable storage can't be resized, replace the buffer and its binding
+  if (lightIndicesSSBO_ != 0) {
+    GlState::deleteBuffer(lightIndicesSSBO_);
+  }
+  glCreateBuffers(1, &lightIndicesSSBO_);
+  glNamedBufferStorage(lightIndicesSSBO_,
+                       lightIndicesCapacity_ * sizeof(uint32_t), nullptr,
+                       GL_DYNAMIC_STORAGE_BIT);
+  GlState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDICES_SSBO_BINDING,
+                          lightIndicesSSBO_);
+}
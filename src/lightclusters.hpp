@@ -0,0 +1,182 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "camera.hpp"
+#include "lightmanager.hpp"
+#include "shader.hpp"
+#include "worker_pool.hpp"
+
+// froxel grid dimensions (x/y tiles in screen space, z slices in depth)
+constexpr unsigned int CLUSTER_GRID_X = 16;
+constexpr unsigned int CLUSTER_GRID_Y = 9;
+constexpr unsigned int CLUSTER_GRID_Z = 24;
+constexpr unsigned int CLUSTER_COUNT =
+    CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+// max lights per cluster when assigning on the GPU (fixed size lists)
+constexpr unsigned int MAX_LIGHTS_PER_CLUSTER = 256;
+// set in a light index to mark a spot light, else it is a point light
+constexpr uint32_t SPOT_LIGHT_INDEX_BIT = 0x80000000u;
+
+// shader storage buffer binding points, see fLightShader.glsl and
+// cClusterLights.glsl
+constexpr unsigned int LIGHT_GRID_SSBO_BINDING = 3;
+constexpr unsigned int LIGHT_INDICES_SSBO_BINDING = 4;
+constexpr unsigned int CLUSTER_BOUNDS_SSBO_BINDING = 5;
+
+/**
+ * @brief Clustered forward lighting.
+ *
+ * The camera frustum is split into a `CLUSTER_GRID_X` x `CLUSTER_GRID_Y` x
+ * `CLUSTER_GRID_Z` froxel grid with exponentially distributed depth slices.
+ * Point and spot lights are assigned to every cluster their bounding sphere
+ * (see `calcLightRadius()`) touches, so a fragment only evaluates the lights
+ * of its own cluster.
+ *
+ * Assignment runs on the CPU (split by depth slice over a `WorkerPool`
+ * started with the clusters) or in a
+ * compute shader. Both produce the same `LightGrid` (offset, count per
+ * cluster) and `LightIndices` buffers.
+ */
+class LightClusters {
+ public:
+  /**
+   * @brief Construct a new Light Clusters object and bind its buffers
+   *
+   */
+  LightClusters();
+
+  /**
+   * @brief Assigns the lights to the clusters of the current view.
+   *
+   * @param camera Camera the frame is rendered with
+   * @param view View matrix of `camera`
+   * @param width Viewport width in pixels
+   * @param height Viewport height in pixels
+   * @param lights with `cullLights()` and `uploadLights()` already done
+   * for this frame
+   *
+   * The FrameData uniform block must be bound for the GPU assignment.
+   */
+  void update(const Camera& camera,
+              const glm::mat4& view,
+              unsigned int width,
+              unsigned int height,
+              const LightManager& lights);
+
+  /**
+   * @brief Select light assignment in a compute shader instead of the CPU
+   *
+   * @param useCompute
+   */
+  void setUseCompute(bool useCompute) { useCompute_ = useCompute; }
+
+  /**
+   * @brief Check if lights are assigned in a compute shader
+   *
+   * @return true
+   * @return false
+   */
+  bool getUseCompute() const { return useCompute_; }
+
+  /**
+   * @brief Get the number of light references written by the last CPU
+   * assignment
+   *
+   * @return unsigned int
+   */
+  unsigned int getLightReferenceCount() const { return referenceCount_; }
+
+ private:
+  // header of the `LightGrid` buffer, followed by one uvec2 per cluster
+  struct GridHeader {
+    uint32_t gridSize[4];  // x, y, z, unused
+    float screen[4];       // viewport width, height, slice scale, slice bias
+  };
+
+  struct ClusterBounds {
+    glm::vec4 min;
+    glm::vec4 max;
+  };
+
+  // light bounding sphere in view space
+  struct LightSphere {
+    glm::vec3 center;
+    float radius;
+    uint32_t index;
+  };
+
+  unsigned int lightGridSSBO_;
+  unsigned int lightIndicesSSBO_;
+  unsigned int clusterBoundsSSBO_;
+  // capacity of `lightIndicesSSBO_` in indices
+  size_t lightIndicesCapacity_;
+
+  bool useCompute_;
+  std::unique_ptr<Shader> computeShader_;
+
+  // view space bounds of each cluster, rebuilt when the projection changes
+  std::vector<ClusterBounds> bounds_;
+  float boundsFov_;
+  float boundsAspect_;
+  float boundsNear_;
+  float boundsFar_;
+
+  // threads of the CPU assignment, each part owns a range of depth slices
+  WorkerPool workers_;
+  std::vector<LightSphere> spheres_;
+  // light indices of each cluster, filled by the assignment threads
+  std::vector<std::vector<uint32_t>> clusterLights_;
+  // flattened `clusterLights_` as uploaded to the GPU
+  std::vector<uint32_t> grid_;
+  std::vector<uint32_t> indices_;
+  unsigned int referenceCount_;
+
+  /**
+   * @brief Recomputes `bounds_` if the projection changed and uploads them
+   *
+   * @param camera
+   * @param aspect
+   */
+  void updateBounds(const Camera& camera, float aspect);
+
+  /**
+   * @brief Assigns `spheres_` to the clusters of the depth slices in
+   * [firstSlice, lastSlice)
+   *
+   * @param firstSlice
+   * @param lastSlice
+   */
+  void assignSlices(unsigned int firstSlice, unsigned int lastSlice);
+
+  /**
+   * @brief Assigns the lights on the CPU and uploads the light grid
+   *
+   * @param view
+   * @param lights
+   */
+  void assignOnCpu(const glm::mat4& view, const LightManager& lights);
+
+  /**
+   * @brief Assigns the lights in the compute shader, which reads the view
+   * matrix from the frame's FrameData block
+   *
+   */
+  void assignOnGpu();
+
+  /**
+   * @brief Makes sure `lightIndicesSSBO_` can hold `count` indices
+   *
+   * @param count
+   */
+  void reserveIndices(size_t count);
+};
+
+#endif
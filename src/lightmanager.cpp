@@ -1,101 +1,262 @@
 #include "lightmanager.hpp"
 
-LightManager::LightManager() {
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "gl_state.hpp"
+
+float calcLightRadius(float constant,
+                      float linear,
+                      float quadratic,
+                      const glm::vec3& color,
+                      float threshold) {
+  float intensity = std::max(color.x, std::max(color.y, color.z));
+  // solve quadratic * d^2 + linear * d + (constant - intensity / threshold)
+  float c = constant - intensity / threshold;
+  if (c >= 0.0f) {
+    // never reaches the threshold, even at distance 0
+    return 0.0f;
+  }
+  if (quadratic > 0.0f) {
+    return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) /
+           (2.0f * quadratic);
+  }
+  if (linear > 0.0f) {
+    return -c / linear;
+  }
+  return std::numeric_limits<float>::infinity();
+}
+
+static glm::vec3 brightestColor(const glm::vec3& ambient,
+                                const glm::vec3& diffuse,
+                                const glm::vec3& specular) {
+  return glm::max(ambient, glm::max(diffuse, specular));
+}
+
+float calcLightRadius(const PointLight& light, float threshold) {
+  return calcLightRadius(
+      light.constant, light.linear, light.quadratic,
+      brightestColor(light.ambient, light.diffuse, light.specular), threshold);
+}
+
+float calcLightRadius(const SpotLight& light, float threshold) {
+  return calcLightRadius(
+      light.constant, light.linear, light.quadratic,
+      brightestColor(light.ambient, light.diffuse, light.specular), threshold);
+}
+
+static GpuDirLight toGpuLight(const DirectionalLight& light) {
+  GpuDirLight gpu = {};
+  gpu.direction = light.direction;
+  gpu.ambient = light.ambient;
+  gpu.diffuse = light.diffuse;
+  gpu.specular = light.specular;
+  return gpu;
+}
+
+static GpuPointLight toGpuLight(const PointLight& light, float threshold) {
+  GpuPointLight gpu = {};
+  gpu.position = light.position;
+  gpu.ambient = light.ambient;
+  gpu.diffuse = light.diffuse;
+  gpu.specular = light.specular;
+  gpu.constant = light.constant;
+  gpu.linear = light.linear;
+  gpu.quadratic = light.quadratic;
+  gpu.radius = calcLightRadius(light, threshold);
+  return gpu;
+}
+
+static GpuSpotLight toGpuLight(const SpotLight& light, float threshold) {
+  GpuSpotLight gpu = {};
+  gpu.position = light.position;
+  gpu.direction = light.direction;
+  gpu.ambient = light.ambient;
+  gpu.diffuse = light.diffuse;
+  gpu.specular = light.specular;
+  gpu.cutOff = light.cutOff;
+  gpu.outerCutOff = light.outerCutOff;
+  gpu.constant = light.constant;
+  gpu.linear = light.linear;
+  gpu.quadratic = light.quadratic;
+  gpu.radius = calcLightRadius(light, threshold);
+  return gpu;
+}
+
+LightManager::LightManager()
+    : dirLightBuffer_(DIR_LIGHTS_SSBO_BINDING, sizeof(GpuDirLight)),
+      pointLightBuffer_(POINT_LIGHTS_SSBO_BINDING, sizeof(GpuPointLight)),
+      spotLightBuffer_(SPOT_LIGHTS_SSBO_BINDING, sizeof(GpuSpotLight)) {
   lightCount_ = 0;
+  gizmoInstanceCapacity_ = 0;
+  gizmoInstanceCount_ = 0;
+  gizmosDirty_ = true;
+  radiusThreshold_ = LIGHT_RADIUS_THRESHOLD;
   setupLightVAO();
 }
 
-bool LightManager::addDirLight(DirectionalLight light) {
-  if (lightCount_ + 1 > MAX_LIGHT_COUNT) {
-    return false;
-  }
+LightHandle LightManager::addDirLight(DirectionalLight light) {
+  GpuDirLight gpu = toGpuLight(light);
   dirLights_.push_back(light);
   lightCount_++;
+  return LightHandle{dirLightBuffer_.push(&gpu)};
+}
+
+LightHandle LightManager::addPointLight(PointLight light) {
+  unsigned int index = pointLights_.size();
+  pointLights_.push_back(light);
+  gpuPointLights_.push_back(toGpuLight(light, radiusThreshold_));
+  // active until the next `cullLights()`
+  activePointLights_.push_back(index);
+  gizmosDirty_ = true;
+  lightCount_++;
+  return LightHandle{index};
+}
+
+LightHandle LightManager::addSpotLight(SpotLight light) {
+  unsigned int index = spotLights_.size();
+  spotLights_.push_back(light);
+  gpuSpotLights_.push_back(toGpuLight(light, radiusThreshold_));
+  // active until the next `cullLights()`
+  activeSpotLights_.push_back(index);
+  gizmosDirty_ = true;
+  lightCount_++;
+  return LightHandle{index};
+}
+
+bool LightManager::updateDirLight(LightHandle handle,
+                                  const DirectionalLight& light) {
+  if (handle.index >= dirLights_.size()) {
+    return false;
+  }
+  dirLights_[handle.index] = light;
+  GpuDirLight gpu = toGpuLight(light);
+  dirLightBuffer_.write(handle.index, &gpu);
   return true;
 }
 
-bool LightManager::addPointLight(PointLight light) {
-  if (lightCount_ + 1 > MAX_LIGHT_COUNT) {
+bool LightManager::updatePointLight(LightHandle handle,
+                                    const PointLight& light) {
+  if (handle.index >= pointLights_.size()) {
     return false;
   }
-  pointLights_.push_back(light);
-  lightCount_++;
+  pointLights_[handle.index] = light;
+  gpuPointLights_[handle.index] = toGpuLight(light, radiusThreshold_);
+  gizmosDirty_ = true;
   return true;
 }
 
-bool LightManager::addSpotLight(SpotLight light) {
-  if (lightCount_ + 1 > MAX_LIGHT_COUNT) {
+bool LightManager::updateSpotLight(LightHandle handle,
+                                   const SpotLight& light) {
+  if (handle.index >= spotLights_.size()) {
     return false;
   }
-  spotLights_.push_back(light);
-  lightCount_++;
+  spotLights_[handle.index] = light;
+  gpuSpotLights_[handle.index] = toGpuLight(light, radiusThreshold_);
+  gizmosDirty_ = true;
   return true;
 }
 
-void LightManager::sendLightsToShader(Shader& shader) const {
-  std::string uniformPrefix;
-
-  shader.setInt("numDirLights", dirLights_.size());
-  for (int i = 0; i < dirLights_.size(); i++) {
-    uniformPrefix = "dirLights[" + std::to_string(i) + "]";
-    shader.setVec3(uniformPrefix + ".direction", dirLights_[i].direction);
-    shader.setVec3(uniformPrefix + ".ambient", dirLights_[i].ambient);
-    shader.setVec3(uniformPrefix + ".diffuse", dirLights_[i].diffuse);
-    shader.setVec3(uniformPrefix + ".specular", dirLights_[i].specular);
-  }
-
-  shader.setInt("numPointLights", pointLights_.size());
-  for (int i = 0; i < pointLights_.size(); i++) {
-    uniformPrefix = "pointLights[" + std::to_string(i) + "]";
-    shader.setVec3(uniformPrefix + ".position", pointLights_[i].position);
-    shader.setVec3(uniformPrefix + ".ambient", pointLights_[i].ambient);
-    shader.setVec3(uniformPrefix + ".diffuse", pointLights_[i].diffuse);
-    shader.setVec3(uniformPrefix + ".specular", pointLights_[i].specular);
-    shader.setFloat(uniformPrefix + ".constant", pointLights_[i].constant);
-    shader.setFloat(uniformPrefix + ".linear", pointLights_[i].linear);
-    shader.setFloat(uniformPrefix + ".quadratic", pointLights_[i].quadratic);
-  }
-
-  shader.setInt("numSpotLights", spotLights_.size());
-  for (int i = 0; i < spotLights_.size(); i++) {
-    uniformPrefix = "spotLights[" + std::to_string(i) + "]";
-    shader.setVec3(uniformPrefix + ".position", spotLights_[i].position);
-    shader.setVec3(uniformPrefix + ".direction", spotLights_[i].direction);
-    shader.setVec3(uniformPrefix + ".ambient", spotLights_[i].ambient);
-    shader.setVec3(uniformPrefix + ".diffuse", spotLights_[i].diffuse);
-    shader.setVec3(uniformPrefix + ".specular", spotLights_[i].specular);
-    shader.setFloat(uniformPrefix + ".cutOff", spotLights_[i].cutOff);
-    shader.setFloat(uniformPrefix + ".outerCutOff", spotLights_[i].outerCutOff);
-    shader.setFloat(uniformPrefix + ".constant", spotLights_[i].constant);
-    shader.setFloat(uniformPrefix + ".linear", spotLights_[i].linear);
-    shader.setFloat(uniformPrefix + ".quadratic", spotLights_[i].quadratic);
-  }
-}
-
-void LightManager::drawLights(Shader& shader,
-                              glm::mat4 view,
-                              glm::mat4 projection) const {
+void LightManager::setRadiusThreshold(float threshold) {
+  radiusThreshold_ = threshold;
+  for (unsigned int i = 0; i < pointLights_.size(); i++) {
+    gpuPointLights_[i].radius = calcLightRadius(pointLights_[i], threshold);
+  }
+  for (unsigned int i = 0; i < spotLights_.size(); i++) {
+    gpuSpotLights_[i].radius = calcLightRadius(spotLights_[i], threshold);
+  }
+}
+
+void LightManager::cullLights(const Frustum& frustum) {
+  activePointLights_.clear();
+  for (unsigned int i = 0; i < gpuPointLights_.size(); i++) {
+    const GpuPointLight& light = gpuPointLights_[i];
+    if (frustum.intersectsSphere(light.position, light.radius)) {
+      activePointLights_.push_back(i);
+    }
+  }
+
+  activeSpotLights_.clear();
+  for (unsigned int i = 0; i < gpuSpotLights_.size(); i++) {
+    const GpuSpotLight& light = gpuSpotLights_[i];
+    if (frustum.intersectsCone(light.position, glm::normalize(light.direction),
+                               light.radius, light.outerCutOff)) {
+      activeSpotLights_.push_back(i);
+    }
+  }
+
+  cullStats_.activePointLights = activePointLights_.size();
+  cullStats_.culledPointLights =
+      pointLights_.size() - activePointLights_.size();
+  cullStats_.activeSpotLights = activeSpotLights_.size();
+  cullStats_.culledSpotLights = spotLights_.size() - activeSpotLights_.size();
+}
+
+void LightManager::uploadLights() {
+  // compact the active lights, only changed entries are marked for upload
+  pointLightBuffer_.resize(activePointLights_.size());
+  for (unsigned int i = 0; i < activePointLights_.size(); i++) {
+    pointLightBuffer_.write(i, &gpuPointLights_[activePointLights_[i]]);
+  }
+  spotLightBuffer_.resize(activeSpotLights_.size());
+  for (unsigned int i = 0; i < activeSpotLights_.size(); i++) {
+    spotLightBuffer_.write(i, &gpuSpotLights_[activeSpotLights_[i]]);
+  }
+
+  dirLightBuffer_.upload();
+  pointLightBuffer_.upload();
+  spotLightBuffer_.upload();
+}
+
+void LightManager::drawLights(Shader& shader) {
+  if (gizmosDirty_) {
+    updateGizmoInstances();
+  }
+  if (gizmoInstanceCount_ == 0) {
+    return;
+  }
+
   shader.use();
-  shader.setMat4("view", view);
-  shader.setMat4("projection", projection);
 
-  glBindVertexArray(lightCubeVAO_);
+  GlState::bindVertexArray(lightCubeVAO_);
+  glDrawArraysInstanced(GL_TRIANGLES, 0, 36, gizmoInstanceCount_);
+}
 
-  for (PointLight light : pointLights_) {
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, light.position);
-    model = glm::scale(model, glm::vec3(light.scale));
-    shader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+void LightManager::updateGizmoInstances() {
+  gizmoInstances_.clear();
+  gizmoInstances_.reserve(pointLights_.size() + spotLights_.size());
+  for (const PointLight& light : pointLights_) {
+    gizmoInstances_.push_back({light.position, light.scale, light.diffuse});
+  }
+  for (const SpotLight& light : spotLights_) {
+    gizmoInstances_.push_back({light.position, light.scale, light.diffuse});
   }
+  gizmoInstanceCount_ = gizmoInstances_.size();
+  gizmosDirty_ = false;
 
-  for (SpotLight light : spotLights_) {
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, light.position);
-    model = glm::scale(model, glm::vec3(light.scale));
-    shader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+  if (gizmoInstanceCount_ == 0) {
+    return;
   }
+
+  if (gizmoInstanceCount_ > gizmoInstanceCapacity_) {
+    // grow geometrically so that adding lights one by one stays cheap.
+    // Immutable storage can't be resized, the VAO gets the new buffer.
+    gizmoInstanceCapacity_ =
+        std::max(gizmoInstanceCount_, gizmoInstanceCapacity_ * 2);
+    if (gizmoInstanceVBO_ != 0) {
+      GlState::deleteBuffer(gizmoInstanceVBO_);
+    }
+    glCreateBuffers(1, &gizmoInstanceVBO_);
+    glNamedBufferStorage(gizmoInstanceVBO_,
+                         gizmoInstanceCapacity_ * sizeof(LightGizmoInstance),
+                         nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glVertexArrayVertexBuffer(lightCubeVAO_, 1, gizmoInstanceVBO_, 0,
+                              sizeof(LightGizmoInstance));
+  }
+  glNamedBufferSubData(gizmoInstanceVBO_, 0,
+                       gizmoInstanceCount_ * sizeof(LightGizmoInstance),
+                       gizmoInstances_.data());
 }
 
 // clang-format off
@@ -146,22 +307,37 @@ static float unitCubeVertices[36 * 6] = {
 // clang-format on
 
 void LightManager::setupLightVAO() {
-  // setup light VAO
-  glGenVertexArrays(1, &lightCubeVAO_);
-  glBindVertexArray(lightCubeVAO_);
   // load vertex data
-  glGenBuffers(1, &lightCubeVBO_);
-  glBindBuffer(GL_ARRAY_BUFFER, lightCubeVBO_);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(unitCubeVertices), unitCubeVertices,
-               GL_STATIC_DRAW);
+  glCreateBuffers(1, &lightCubeVBO_);
+  glNamedBufferStorage(lightCubeVBO_, sizeof(unitCubeVertices),
+                       unitCubeVertices, 0);
+
+  // setup light VAO, vertices from binding 0
+  glCreateVertexArrays(1, &lightCubeVAO_);
+  glVertexArrayVertexBuffer(lightCubeVAO_, 0, lightCubeVBO_, 0,
+                            6 * sizeof(float));
   // set position attribute
-  /* func(attr_pos, sizeof_vertex_attr, type_data, norm, stride, offset) */
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
+  glEnableVertexArrayAttrib(lightCubeVAO_, 0);
+  glVertexArrayAttribFormat(lightCubeVAO_, 0, 3, GL_FLOAT, GL_FALSE, 0);
+  glVertexArrayAttribBinding(lightCubeVAO_, 0, 0);
   // set normal vector
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float),
-                        (void*)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
+  glEnableVertexArrayAttrib(lightCubeVAO_, 1);
+  glVertexArrayAttribFormat(lightCubeVAO_, 1, 3, GL_FLOAT, GL_FALSE,
+                            3 * sizeof(float));
+  glVertexArrayAttribBinding(lightCubeVAO_, 1, 0);
 
-  glBindVertexArray(0);
+  // per-instance data from binding 1, the buffer is created by
+  // `updateGizmoInstances()`
+  gizmoInstanceVBO_ = 0;
+  glVertexArrayBindingDivisor(lightCubeVAO_, 1, 1);
+  // set instance position and scale
+  glEnableVertexArrayAttrib(lightCubeVAO_, 2);
+  glVertexArrayAttribFormat(lightCubeVAO_, 2, 4, GL_FLOAT, GL_FALSE,
+                            offsetof(LightGizmoInstance, position));
+  glVertexArrayAttribBinding(lightCubeVAO_, 2, 1);
+  // set instance color
+  glEnableVertexArrayAttrib(lightCubeVAO_, 3);
+  glVertexArrayAttribFormat(lightCubeVAO_, 3, 3, GL_FLOAT, GL_FALSE,
+                            offsetof(LightGizmoInstance, color));
+  glVertexArrayAttribBinding(lightCubeVAO_, 3, 1);
 }
\ No newline at end of file
@@ -1,13 +1,25 @@
 #ifndef LIGHTMANAGER_H
 #define LIGHTMANAGER_H
 
+#include <cstddef>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
 
+#include "frustum.hpp"
 #include "shader.hpp"
+#include "storage_buffer.hpp"
 
-constexpr unsigned int MAX_LIGHT_COUNT = 16;
+// shader storage buffer binding points of the light blocks in
+// fLightShader.glsl
+constexpr unsigned int DIR_LIGHTS_SSBO_BINDING = 0;
+constexpr unsigned int POINT_LIGHTS_SSBO_BINDING = 1;
+constexpr unsigned int SPOT_LIGHTS_SSBO_BINDING = 2;
+
+// default for `LightManager::setRadiusThreshold()`: a light is considered to
+// have no visible effect once its attenuated brightest color channel drops
+// below this value (5 steps in 8 bit color)
+constexpr float LIGHT_RADIUS_THRESHOLD = 5.0f / 256.0f;
 
 struct DirectionalLight {
   glm::vec3 direction;
@@ -92,15 +104,122 @@ struct SpotLight {
   float scale;  // size of rendered cube
 };
 
+// std430 mirrors of the light structs in fLightShader.glsl. Every vec3 is
+// followed by a float so that each pair fills one 16 byte slot.
+
+struct GpuDirLight {
+  glm::vec3 direction;
+  float pad0;
+  glm::vec3 ambient;
+  float pad1;
+  glm::vec3 diffuse;
+  float pad2;
+  glm::vec3 specular;
+  float pad3;
+};
+
+struct GpuPointLight {
+  glm::vec3 position;
+  float constant;
+  glm::vec3 ambient;
+  float linear;
+  glm::vec3 diffuse;
+  float quadratic;
+  glm::vec3 specular;
+  float radius;  // see `calcLightRadius()`
+};
+
+struct GpuSpotLight {
+  glm::vec3 position;
+  float constant;
+  glm::vec3 direction;
+  float linear;
+  glm::vec3 ambient;
+  float quadratic;
+  glm::vec3 diffuse;
+  float cutOff;
+  glm::vec3 specular;
+  float outerCutOff;
+  float radius;  // see `calcLightRadius()`
+  float pad0;
+  float pad1;
+  float pad2;
+};
+
+static_assert(sizeof(glm::vec3) == 12, "glm::vec3 must be tightly packed");
+static_assert(sizeof(GpuDirLight) == 64 && alignof(GpuDirLight) == 4,
+              "GpuDirLight does not match std430 layout");
+static_assert(sizeof(GpuPointLight) == 64 && alignof(GpuPointLight) == 4,
+              "GpuPointLight does not match std430 layout");
+static_assert(sizeof(GpuSpotLight) == 96 && alignof(GpuSpotLight) == 4,
+              "GpuSpotLight does not match std430 layout");
+static_assert(offsetof(GpuSpotLight, specular) == 64,
+              "GpuSpotLight does not match std430 layout");
+
+/**
+ * @brief Calculates the distance at which a light's contribution drops
+ * below `threshold`, by solving
+ *
+ * K_c + (K_l * d) + (K_q * d^2) = intensity / threshold
+ *
+ * @param constant attenuation variable K_c
+ * @param linear attenuation variable K_l
+ * @param quadratic attenuation variable K_q
+ * @param color brightest of the light's ambient/diffuse/specular colors
+ * @param threshold
+ * @return float radius, infinite if the light never drops below threshold
+ */
+float calcLightRadius(float constant,
+                      float linear,
+                      float quadratic,
+                      const glm::vec3& color,
+                      float threshold = LIGHT_RADIUS_THRESHOLD);
+
+/**
+ * @brief Get the effective radius of a PointLight, see `calcLightRadius()`
+ *
+ * @param light
+ * @param threshold
+ * @return float
+ */
+float calcLightRadius(const PointLight& light,
+                      float threshold = LIGHT_RADIUS_THRESHOLD);
+
+/**
+ * @brief Get the effective radius of a SpotLight, see `calcLightRadius()`
+ *
+ * @param light
+ * @param threshold
+ * @return float
+ */
+float calcLightRadius(const SpotLight& light,
+                      float threshold = LIGHT_RADIUS_THRESHOLD);
+
+// per-instance attributes of a light cube in vLightCubeShader.glsl
+struct LightGizmoInstance {
+  glm::vec3 position;
+  float scale;
+  glm::vec3 color;
+};
+
+// per-frame light culling results, see `LightManager::cullLights()`
+struct LightCullStats {
+  unsigned int activePointLights = 0;
+  unsigned int culledPointLights = 0;
+  unsigned int activeSpotLights = 0;
+  unsigned int culledSpotLights = 0;
+};
+
+// handle returned by the add*Light functions, identifies a light of one type
+struct LightHandle {
+  unsigned int index;
+};
+
 class LightManager {
  public:
   // VAO to be used when drawing light cubes
   unsigned int lightCubeVAO_;
 
-  std::vector<DirectionalLight> dirLights_;
-  std::vector<PointLight> pointLights_;
-  std::vector<SpotLight> spotLights_;
-
   /**
    * @brief Construct a new Light Manager object
    *
@@ -135,16 +254,85 @@ class LightManager {
    */
   unsigned int getSpotLightCount() const { return spotLights_.size(); }
 
+  const std::vector<DirectionalLight>& getDirLights() const {
+    return dirLights_;
+  }
+  const std::vector<PointLight>& getPointLights() const {
+    return pointLights_;
+  }
+  const std::vector<SpotLight>& getSpotLights() const { return spotLights_; }
+
+  /**
+   * @brief Get the indices (into `getPointLights()`) of the point lights
+   * that survived culling, in the order they are uploaded to the GPU
+   *
+   * @return const std::vector<unsigned int>&
+   */
+  const std::vector<unsigned int>& getActivePointLights() const {
+    return activePointLights_;
+  }
+
+  /**
+   * @brief Get the indices (into `getSpotLights()`) of the spot lights that
+   * survived culling, in the order they are uploaded to the GPU
+   *
+   * @return const std::vector<unsigned int>&
+   */
+  const std::vector<unsigned int>& getActiveSpotLights() const {
+    return activeSpotLights_;
+  }
+
+  /**
+   * @brief Get the effective radius of the point light at `index`
+   *
+   * @param index
+   * @return float
+   */
+  float getPointLightRadius(unsigned int index) const {
+    return gpuPointLights_[index].radius;
+  }
+
+  /**
+   * @brief Get the effective radius of the spot light at `index`
+   *
+   * @param index
+   * @return float
+   */
+  float getSpotLightRadius(unsigned int index) const {
+    return gpuSpotLights_[index].radius;
+  }
+
+  /**
+   * @brief Set the intensity below which a light is considered to have no
+   * effect, recomputes all light radii
+   *
+   * @param threshold
+   */
+  void setRadiusThreshold(float threshold);
+
+  /**
+   * @brief Get the intensity threshold used for light radii
+   *
+   * @return float
+   */
+  float getRadiusThreshold() const { return radiusThreshold_; }
+
+  /**
+   * @brief Get the culling results of the last `cullLights()` call
+   *
+   * @return const LightCullStats&
+   */
+  const LightCullStats& getCullStats() const { return cullStats_; }
+
   /**
    * @brief Adds a `DirectionalLight` to the LightManager.
    *
    * The added light will be rendered on consequent calls to the scene.
    *
    * @param light
-   * @return true
-   * @return false
+   * @return LightHandle to update the light with
    */
-  bool addDirLight(DirectionalLight light);
+  LightHandle addDirLight(DirectionalLight light);
 
   /**
    * @brief Adds a `PointLight` to the LightManager.
@@ -152,10 +340,9 @@ class LightManager {
    * The added light will be rendered on consequent calls to the scene.
    *
    * @param light
-   * @return true on success,
-   * @return false on failure
+   * @return LightHandle to update the light with
    */
-  bool addPointLight(PointLight light);
+  LightHandle addPointLight(PointLight light);
 
   /**
    * @brief Adds a `SpotLight` to the LightManager.
@@ -163,41 +350,117 @@ class LightManager {
    * The added light will be rendered on consequent calls to the scene.
    *
    * @param light
+   * @return LightHandle to update the light with
+   */
+  LightHandle addSpotLight(SpotLight light);
+
+  /**
+   * @brief Replaces a `DirectionalLight`. Only marks the light buffer dirty
+   * if a value actually changed.
+   *
+   * @param handle returned by `addDirLight()`
+   * @param light
    * @return true on success,
-   * @return false on failure
+   * @return false if `handle` is invalid
    */
-  bool addSpotLight(SpotLight light);
+  bool updateDirLight(LightHandle handle, const DirectionalLight& light);
 
   /**
-   * @brief Sets uniforms on Shader for all lights.
+   * @brief Replaces a `PointLight`. Only marks the light buffer dirty if a
+   * value actually changed.
    *
-   * Lights can be accessed on the shader from the following 3 arrays:
+   * @param handle returned by `addPointLight()`
+   * @param light
+   * @return true on success,
+   * @return false if `handle` is invalid
+   */
+  bool updatePointLight(LightHandle handle, const PointLight& light);
+
+  /**
+   * @brief Replaces a `SpotLight`. Only marks the light buffer dirty if a
+   * value actually changed.
    *
-   * `dirLights[]`
+   * @param handle returned by `addSpotLight()`
+   * @param light
+   * @return true on success,
+   * @return false if `handle` is invalid
+   */
+  bool updateSpotLight(LightHandle handle, const SpotLight& light);
+
+  /**
+   * @brief Culls point and spot lights against the camera frustum.
    *
-   * `pointLights[]`
+   * Point lights are tested as spheres and spot lights as cones of their
+   * effective radius. Only the surviving lights are uploaded by
+   * `uploadLights()`. Without a call to this, all lights are active.
    *
-   * `spotLights[]`
+   * @param frustum
+   */
+  void cullLights(const Frustum& frustum);
+
+  /**
+   * @brief Uploads the active lights to the light storage buffers.
    *
-   * @param shader
+   * The buffers are bound to `*_LIGHTS_SSBO_BINDING` and shared by every
+   * program that declares the light blocks. Only the lights changed since
+   * the last call are uploaded, nothing is uploaded if neither a light nor
+   * the set of active lights changed.
    */
-  void sendLightsToShader(Shader& shader) const;
+  void uploadLights();
 
   /**
-   * @brief Draws light sources as cubes for visualization purposes
+   * @brief Draws all point and spot lights as cubes for visualization
+   * purposes, with a single instanced draw call
+   *
+   * The per-instance buffer is only refreshed when a light was added or
+   * updated since the last call.
    *
+   * The camera comes from the bound FrameData uniform block.
+   *
+   * @param shader
    */
-  void drawLights(Shader& shader, glm::mat4 view, glm::mat4 projection) const;
+  void drawLights(Shader& shader);
 
  private:
   unsigned int lightCubeVBO_;
+  // per-instance position, scale and color of every light cube
+  unsigned int gizmoInstanceVBO_;
+  unsigned int gizmoInstanceCapacity_;
+  unsigned int gizmoInstanceCount_;
+  bool gizmosDirty_;
+  std::vector<LightGizmoInstance> gizmoInstances_;
   unsigned int lightCount_;
 
+  std::vector<DirectionalLight> dirLights_;
+  std::vector<PointLight> pointLights_;
+  std::vector<SpotLight> spotLights_;
+
+  float radiusThreshold_;
+  // GPU layout copies of all point/spot lights, including their radius
+  std::vector<GpuPointLight> gpuPointLights_;
+  std::vector<GpuSpotLight> gpuSpotLights_;
+
+  // lights that survived culling
+  std::vector<unsigned int> activePointLights_;
+  std::vector<unsigned int> activeSpotLights_;
+  LightCullStats cullStats_;
+
+  // GPU copies of the active lights, one storage buffer per light type
+  StorageBuffer dirLightBuffer_;
+  StorageBuffer pointLightBuffer_;
+  StorageBuffer spotLightBuffer_;
+
   /**
    * @brief Creates the VAO to render a light source (currently just a square)
    *
    */
   void setupLightVAO();
+
+  /**
+   * @brief Rebuilds the per-instance light cube data and uploads it
+   *
+   */
+  void updateGizmoInstances();
 };
 
 #endif
\ No newline at end of file
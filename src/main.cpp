@@ -5,17 +5,42 @@
 
 #include <iostream>
 #include <memory>
+#include <string>
 
+#include "frustum.hpp"
+#include "gl_state.hpp"
+#include "lightclusters.hpp"
 #include "lightmanager.hpp"
+#include "ring_buffer.hpp"
+#include "scene/bvh_benchmark.hpp"
 #include "scene/model.hpp"
 #include "scene/scene.hpp"
 #include "shader.hpp"
+#include "shader_variants.hpp"
 #include "window.hpp"
 
 const unsigned int SCR_WIDTH = 1200;  // screen width
 const unsigned int SCR_HEIGHT = 800;  // screen height
 
-int main() {
+/**
+ * @brief Formats program, texture and vertex array changes for the title
+ *
+ * @param changes
+ * @return std::string
+ */
+static std::string formatStateChanges(const RenderStateChanges& changes) {
+  return std::to_string(changes.programs) + "p " +
+         std::to_string(changes.textures) + "t " +
+         std::to_string(changes.vertexArrays) + "v";
+}
+
+int main(int argc, char** argv) {
+  // CPU only benchmark, no window needed
+  if (argc > 1 && std::string(argv[1]) == "--bench-bvh") {
+    runBvhBenchmark();
+    return 0;
+  }
+
   /*
     SETUP
   */
@@ -36,109 +61,210 @@ int main() {
   /*
     SHADERS
   */
-  Shader basicShader("./shaders/vLightShader.glsl",
-                     "./shaders/fLightShader.glsl");
+  // permutations are compiled lazily on first use
+  ShaderVariants litShaders("./shaders/vLightShader.glsl",
+                            "./shaders/fLightShader.glsl");
 
   Shader lightCubeShader("./shaders/vLightCubeShader.glsl",
                          "./shaders/fLightCubeShader.glsl");
 
-  /*
-    LIGHT MANAGER
-  */
-  LightManager lightManager;
-
-  // generic directional light
-  lightManager.addDirLight({.direction = glm::vec3(0.0f, -1.0f, -1.0f),
-                            .ambient = glm::vec3(0.05f, 0.05f, 0.05f),
-                            .diffuse = glm::vec3(0.4f, 0.4f, 0.4f),
-                            .specular = glm::vec3(1.0f, 1.0f, 1.0f)});
-
-  // blue-ish light
-  lightManager.addPointLight({.position = glm::vec3(-2.0f, 2.0f, -5.0f),
-                              .ambient = glm::vec3(0.0f, 0.0f, 0.0f),
-                              .diffuse = glm::vec3(0.2f, 0.2f, 0.7f),
-                              .specular = glm::vec3(1.0f, 1.0f, 1.0f),
-                              .constant = 1.0f,
-                              .linear = 0.0014f,
-                              .quadratic = 0.000007f,
-                              .scale = 0.3f});
-
-  // orange-ish light
-  lightManager.addSpotLight({.position = glm::vec3(0.0f, 4.0f, 0.3f),
-                             .direction = glm::vec3(0.0f, -1.0f, 0.0f),
-                             .ambient = glm::vec3(0.0f, 0.0f, 0.0f),
-                             .diffuse = glm::vec3(0.7f, 0.4f, 0.2f),
-                             .specular = glm::vec3(1.0f, 1.0f, 1.0f),
-                             .cutOff = glm::cos(glm::radians(12.5f)),
-                             .outerCutOff = glm::cos(glm::radians(18.0f)),
-                             .constant = 1.0f,
-                             .linear = 0.0014f,
-                             .quadratic = 0.000007f,
-                             .scale = 0.3f});
-
-  basicShader.use();
-  lightManager.sendLightsToShader(basicShader);
+  // the objects below free GL resources when destroyed, so they go out of
+  // scope while the context still exists
+  {
+    /*
+      LIGHT MANAGER
+    */
+    LightManager lightManager;
 
-  /*
-    MODELS
-  */
-  Scene scene;
+    // generic directional light
+    lightManager.addDirLight({.direction = glm::vec3(0.0f, -1.0f, -1.0f),
+                              .ambient = glm::vec3(0.05f, 0.05f, 0.05f),
+                              .diffuse = glm::vec3(0.4f, 0.4f, 0.4f),
+                              .specular = glm::vec3(1.0f, 1.0f, 1.0f)});
+
+    // blue-ish light
+    lightManager.addPointLight({.position = glm::vec3(-2.0f, 2.0f, -5.0f),
+                                .ambient = glm::vec3(0.0f, 0.0f, 0.0f),
+                                .diffuse = glm::vec3(0.2f, 0.2f, 0.7f),
+                                .specular = glm::vec3(1.0f, 1.0f, 1.0f),
+                                .constant = 1.0f,
+                                .linear = 0.0014f,
+                                .quadratic = 0.000007f,
+                                .scale = 0.3f});
+
+    // orange-ish light
+    lightManager.addSpotLight({.position = glm::vec3(0.0f, 4.0f, 0.3f),
+                               .direction = glm::vec3(0.0f, -1.0f, 0.0f),
+                               .ambient = glm::vec3(0.0f, 0.0f, 0.0f),
+                               .diffuse = glm::vec3(0.7f, 0.4f, 0.2f),
+                               .specular = glm::vec3(1.0f, 1.0f, 1.0f),
+                               .cutOff = glm::cos(glm::radians(12.5f)),
+                               .outerCutOff = glm::cos(glm::radians(18.0f)),
+                               .constant = 1.0f,
+                               .linear = 0.0014f,
+                               .quadratic = 0.000007f,
+                               .scale = 0.3f});
+
+    // clustered forward lighting for point and spot lights, toggle with C to
+    // compare against looping over all lights. G toggles light assignment in
+    // a compute shader.
+    LightClusters lightClusters;
+    bool clustered = true;
+    // M toggles multi-draw-indirect rendering of the scene
+    bool multiDraw = false;
+    // T toggles sampling the materials from texture arrays
+    bool materialArrays = false;
+
+    glm::mat4 view;
+    glm::mat4 projection;
+
+    /*
+      MODELS
+    */
+    Scene scene;
+
+    glm::vec3 position = glm::vec3(0.0f, 1.2f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
+
+    scene.addModelEntity(
+        scene.getOrCreateModel("./assets/models/backpack/backpack.obj"),
+        Transform(position, scale));
+
+    position = glm::vec3(1.0f, 0.0f, 3.0f);
+    // scene.addModelEntity(
+    //     scene.getOrCreateModel("./assets/models/backpack/backpack.obj"),
+    //     Transform(position, scale));
+
+    scene.addMeshEntity(scene.getOrCreateMesh("box"),
+                        Transform(position, scale),
+                        glm::vec3(0.2f, 0.3f, 0.2f));
+
+    position = glm::vec3(0.0f, -1.0f, 0.0f);
+    scale = glm::vec3(10.0f, 1.0f, 10.0f);
+    scene.addMeshEntity(scene.getOrCreateMesh("box"),
+                        Transform(position, scale),
+                        glm::vec3(0.9f, 0.9f, 0.9f));
+
+    std::cout << "Index memory saved by 16 bit indices: "
+              << scene.getIndexMemorySaved() / 1024 << " KiB" << std::endl;
+
+    // nothing is known about the state of the fresh context
+    GlState::invalidate();
+    GlState::setEnabled(GL_DEPTH_TEST, true);
+
+    // per-frame data (camera block, instances, indirect commands) is streamed
+    // through one persistently mapped buffer, grows if a frame needs more
+    RingBuffer frameRing(1 << 20);
 
-  glm::vec3 position = glm::vec3(0.0f, 1.2f, 0.0f);
-  glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
+    while (!glfwWindowShouldClose(window.window_)) {
+      window.updateDeltaTime();
+      window.processInput();
+      Shader::resetStats();
+      GlState::resetStats();
+      frameRing.beginFrame();
 
-  std::unique_ptr<Entity> guitar = std::make_unique<ModelEntity>(
-      scene.getOrCreateModel("./assets/models/backpack/backpack.obj"),
-      Transform(position, scale));
+      if (window.keyPressed(GLFW_KEY_C)) {
+        clustered = !clustered;
+        std::cout << "Lighting: " << (clustered ? "clustered" : "brute force")
+                  << std::endl;
+      }
+      if (window.keyPressed(GLFW_KEY_G)) {
+        lightClusters.setUseCompute(!lightClusters.getUseCompute());
+        std::cout << "Light assignment: "
+                  << (lightClusters.getUseCompute() ? "compute shader" : "CPU")
+                  << std::endl;
+      }
 
-  scene.addEntity(std::move(guitar));
+      if (window.keyPressed(GLFW_KEY_M)) {
+        multiDraw = !multiDraw;
+        scene.setMultiDraw(multiDraw);
+        std::cout << "Scene draws: "
+                  << (multiDraw ? "multi-draw-indirect" : "instanced")
+                  << std::endl;
+      }
 
-  position = glm::vec3(1.0f, 0.0f, 3.0f);
-  // std::unique_ptr<Entity> guitar2 = std::make_unique<ModelEntity>(
-  //     scene.getOrCreateModel("./assets/models/backpack/backpack.obj"),
-  //     Transform(position, scale));
+      if (window.keyPressed(GLFW_KEY_T)) {
+        materialArrays = !materialArrays;
+        scene.setMaterialArrays(materialArrays);
+        std::cout << "Materials: "
+                  << (materialArrays ? "texture arrays" : "bound per material")
+                  << std::endl;
+      }
 
-  std::unique_ptr<Entity> box = std::make_unique<MeshEntity>(
-      scene.getOrCreateMesh("box"), Transform(position, scale),
-      glm::vec3(0.2f, 0.3f, 0.2f));
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  position = glm::vec3(0.0f, -1.0f, 0.0f);
-  scale = glm::vec3(10.0f, 1.0f, 10.0f);
-  std::unique_ptr<Entity> box2 = std::make_unique<MeshEntity>(
-      scene.getOrCreateMesh("box"), Transform(position, scale),
-      glm::vec3(0.9f, 0.9f, 0.9f));
+      view = camera.getViewMatrix();
+      projection = camera.getProjectionMatrix((float)window.getWidth() /
+                                              (float)window.getHeight());
 
-  scene.addEntity(std::move(box));
-  scene.addEntity(std::move(box2));
+      Frustum frustum(projection * view);
 
-  glEnable(GL_DEPTH_TEST);
+      // camera block shared by every program through FRAME_UBO_BINDING
+      GpuFrameData frameData = {view, projection, camera.Position, 0.0f};
+      frameRing.bindRange(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING,
+                          frameRing.push(&frameData, sizeof(frameData)));
 
-  while (!glfwWindowShouldClose(window.window_)) {
-    window.updateDeltaTime();
-    window.processInput();
+      // only lights that can affect the visible scene are uploaded
+      lightManager.cullLights(frustum);
+      lightManager.uploadLights();
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      if (clustered) {
+        lightClusters.update(camera, view, window.getWidth(),
+                             window.getHeight(), lightManager);
+        // point and spot lights come from the clusters, not the counts
+        litShaders.setBaseKey(
+            makeLightVariantKey(lightManager.getDirectionalLightCount(), 0, 0) |
+            VARIANT_CLUSTERED);
+      } else {
+        // keyed on all lights, culling only changes the loop counts
+        litShaders.setBaseKey(makeLightVariantKey(
+            lightManager.getDirectionalLightCount(),
+            lightManager.getPointLightCount(),
+            lightManager.getSpotLightCount()));
+      }
 
-    basicShader.use();
-    glm::mat4 view = camera.getViewMatrix();
-    glm::mat4 projection = glm::perspective(
-        glm::radians(camera.Fov),
-        (float)window.getWidth() / (float)window.getHeight(), 0.1f, 100.0f);
+      scene.draw(litShaders, frustum, frameRing);
 
-    basicShader.setMat4("view", view);
-    basicShader.setMat4("projection", projection);
+      lightManager.drawLights(lightCubeShader);
 
-    scene.draw(basicShader);
+      const LightCullStats& lightStats = lightManager.getCullStats();
+      window.setStatus(
+          "point lights: " + std::to_string(lightStats.activePointLights) +
+          "/" +
+          std::to_string(lightStats.activePointLights +
+                         lightStats.culledPointLights) +
+          " - spot lights: " + std::to_string(lightStats.activeSpotLights) +
+          "/" +
+          std::to_string(lightStats.activeSpotLights +
+                         lightStats.culledSpotLights) +
+          " - entities: " + std::to_string(scene.getVisibleEntityCount()) +
+          "/" + std::to_string(scene.getEntityCount()) +
+          " - draws: " + std::to_string(scene.getBatcher().getDrawCount()) +
+          " instances: " +
+          std::to_string(scene.getBatcher().getInstanceCount()) +
+          " - state changes (unsorted/sorted): " +
+          formatStateChanges(scene.getBatcher().getUnsortedStateChanges()) +
+          " / " + formatStateChanges(scene.getBatcher().getStateChanges()) +
+          " - gl state calls: " + std::to_string(GlState::stats().calls) +
+          " (skipped " + std::to_string(GlState::stats().skipped) + ")" +
+          " - ring stalls: " + std::to_string(frameRing.getStallCount()));
 
-    lightManager.drawLights(lightCubeShader, view, projection);
+      // uniform locations are resolved when linking, a steady-state frame must
+      // not query the driver for them
+      if (Shader::stats().locationQueries > 0) {
+        std::cout << "WARNING::SHADER::UNIFORM_LOCATION_QUERIES: "
+                  << Shader::stats().locationQueries << std::endl;
+      }
 
-    glfwSwapBuffers(window.window_);
-    glfwPollEvents();
+      frameRing.endFrame();
+      glfwSwapBuffers(window.window_);
+      glfwPollEvents();
+    }
   }
 
   // clean / delete all of GLFW's resources that were allocated
-  glDeleteProgram(basicShader.ID);
-  glDeleteProgram(lightCubeShader.ID);
+  litShaders.deleteAll();
+  GlState::deleteProgram(lightCubeShader.ID);
   glfwTerminate();
   return 0;
 }
\ No newline at end of file
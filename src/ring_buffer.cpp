@@ -0,0 +1,134 @@
+#include "ring_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "gl_state.hpp"
+
+// how long one wait for a fence may block before checking again
+static const GLuint64 FENCE_WAIT_TIMEOUT_NS = 1000000;
+
+static const GLbitfield RING_BUFFER_FLAGS =
+    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+RingBuffer::RingBuffer(size_t frameSize) {
+  buffer_ = 0;
+  mapped_ = nullptr;
+  frame_ = 0;
+  offset_ = 0;
+  stalls_ = 0;
+  for (GLsync& fence : fences_) {
+    fence = nullptr;
+  }
+
+  // indirect commands only need 4 bytes, std430/std140 data 16
+  GLint uniformAlignment = 0;
+  GLint storageAlignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+  alignment_ = std::max<size_t>(
+      16, std::max(uniformAlignment, storageAlignment));
+
+  create(frameSize);
+}
+
+RingBuffer::~RingBuffer() {
+  for (GLsync fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  // deleting the buffer also unmaps it
+  for (unsigned int buffer : retired_) {
+    GlState::deleteBuffer(buffer);
+  }
+  GlState::deleteBuffer(buffer_);
+}
+
+void RingBuffer::beginFrame() {
+  frame_ = (frame_ + 1) % RING_BUFFER_FRAMES;
+  offset_ = 0;
+
+  GLsync& fence = fences_[frame_];
+  if (!fence) {
+    return;
+  }
+  GLenum result = glClientWaitSync(fence, 0, 0);
+  if (result == GL_TIMEOUT_EXPIRED) {
+    // the GPU is RING_BUFFER_FRAMES frames behind
+    stalls_++;
+    do {
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                FENCE_WAIT_TIMEOUT_NS);
+    } while (result == GL_TIMEOUT_EXPIRED);
+  }
+  if (result == GL_WAIT_FAILED) {
+    std::cout << "ERROR::RING_BUFFER::FENCE_WAIT_FAILED" << std::endl;
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+}
+
+void RingBuffer::endFrame() {
+  // the frame's commands are issued, the driver keeps the storage of
+  // replaced buffers alive until they completed
+  for (unsigned int buffer : retired_) {
+    GlState::deleteBuffer(buffer);
+  }
+  retired_.clear();
+
+  if (fences_[frame_]) {
+    glDeleteSync(fences_[frame_]);
+  }
+  fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+RingAllocation RingBuffer::allocate(size_t size) {
+  size_t offset = (offset_ + alignment_ - 1) / alignment_ * alignment_;
+  if (offset + size > frameSize_) {
+    // earlier allocations of this frame stay valid in the old buffer
+    create(std::max(frameSize_ * 2, size));
+    offset = 0;
+  }
+  offset_ = offset + size;
+
+  size_t absolute = frame_ * frameSize_ + offset;
+  return {mapped_ + absolute, buffer_, absolute, size};
+}
+
+RingAllocation RingBuffer::push(const void* data, size_t size) {
+  RingAllocation allocation = allocate(size);
+  std::memcpy(allocation.data, data, size);
+  return allocation;
+}
+
+void RingBuffer::bindRange(GLenum target,
+                           unsigned int binding,
+                           const RingAllocation& allocation) const {
+  GlState::bindBufferRange(target, binding, allocation.buffer,
+                           allocation.offset, allocation.size);
+}
+
+void RingBuffer::create(size_t frameSize) {
+  // deleting a buffer unbinds it, allocations of this frame may still be
+  // bound from it
+  if (buffer_ != 0) {
+    retired_.push_back(buffer_);
+  }
+  // the fences guarded regions of the old buffer, every region of the new
+  // one is free
+  for (GLsync& fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+
+  frameSize_ = (frameSize + alignment_ - 1) / alignment_ * alignment_;
+  glCreateBuffers(1, &buffer_);
+  glNamedBufferStorage(buffer_, frameSize_ * RING_BUFFER_FRAMES, nullptr,
+                       RING_BUFFER_FLAGS);
+  mapped_ = (char*)glMapNamedBufferRange(
+      buffer_, 0, frameSize_ * RING_BUFFER_FRAMES, RING_BUFFER_FLAGS);
+}
@@ -0,0 +1,141 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// frames the CPU may run ahead of the GPU, each writes its own region
+constexpr unsigned int RING_BUFFER_FRAMES = 3;
+
+// range of the ring written during the current frame
+struct RingAllocation {
+  // mapped memory, write only
+  void* data;
+  // GL buffer holding the range, a later allocation of the same frame may
+  // already come from a grown replacement
+  unsigned int buffer;
+  // offset in `buffer`
+  size_t offset;
+  size_t size;
+};
+
+/**
+ * @brief Persistently and coherently mapped buffer for data that is written
+ * once per frame.
+ *
+ * The buffer is split into `RING_BUFFER_FRAMES` regions. Every frame
+ * bump-allocates from the next region once the fence of the frame that used
+ * it before has signaled, so the GPU never reads data that is being
+ * overwritten. Writes are plain memcpy into the mapping and consumers bind
+ * their allocations with `bindRange()`.
+ *
+ * A frame that outgrows its region continues in a new buffer with twice the
+ * region size. The old buffer is deleted at the end of the frame and freed
+ * by the driver once the GPU is done with it.
+ */
+class RingBuffer {
+ public:
+  /**
+   * @brief Construct a new Ring Buffer object
+   *
+   * @param frameSize initial bytes available to each frame
+   */
+  explicit RingBuffer(size_t frameSize);
+
+  /**
+   * @brief Deletes the fences and buffers, the GL context must still be
+   * current
+   *
+   */
+  ~RingBuffer();
+
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  /**
+   * @brief Moves to the next region, waiting for the GPU if it still reads
+   * it
+   *
+   */
+  void beginFrame();
+
+  /**
+   * @brief Fences the current region after the frame's commands
+   *
+   */
+  void endFrame();
+
+  /**
+   * @brief Allocates `size` bytes from the current frame's region
+   *
+   * Allocations are aligned for uniform, shader storage and indirect
+   * buffer offsets.
+   *
+   * @param size
+   * @return RingAllocation
+   */
+  RingAllocation allocate(size_t size);
+
+  /**
+   * @brief Allocates and copies `size` bytes
+   *
+   * @param data
+   * @param size
+   * @return RingAllocation
+   */
+  RingAllocation push(const void* data, size_t size);
+
+  /**
+   * @brief Binds an allocation of this frame to an indexed binding point,
+   * using the buffer it was allocated from
+   *
+   * @param target `GL_UNIFORM_BUFFER` or `GL_SHADER_STORAGE_BUFFER`
+   * @param binding
+   * @param allocation
+   */
+  void bindRange(GLenum target,
+                 unsigned int binding,
+                 const RingAllocation& allocation) const;
+
+  /**
+   * @brief Get the GL buffer name, replaced when the ring grows. Bind
+   * allocations through `RingAllocation::buffer` instead.
+   *
+   * @return unsigned int
+   */
+  unsigned int getBuffer() const { return buffer_; }
+
+  /**
+   * @brief Get the number of frames that had to wait for the GPU
+   *
+   * @return unsigned int
+   */
+  unsigned int getStallCount() const { return stalls_; }
+
+ private:
+  unsigned int buffer_;
+  char* mapped_;
+  size_t frameSize_;
+  size_t alignment_;
+
+  // region of the current frame and the bump offset inside it
+  unsigned int frame_;
+  size_t offset_;
+  // per region, signaled when the GPU finished the frame that wrote it
+  GLsync fences_[RING_BUFFER_FRAMES];
+  unsigned int stalls_;
+  // buffers replaced during the current frame
+  std::vector<unsigned int> retired_;
+
+  /**
+   * @brief Creates and maps a buffer of `RING_BUFFER_FRAMES` regions,
+   * replacing the current one
+   *
+   * @param frameSize
+   */
+  void create(size_t frameSize);
+};
+
+#endif
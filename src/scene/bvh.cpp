@@ -0,0 +1,627 @@
+#include "scene/bvh.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+// traversal stack entries, enough for `BVH_MAX_DEPTH`
+static const unsigned int STACK_SIZE = 96;
+// set on culling stack entries of nodes known to be inside the frustum
+static const unsigned int STACK_INSIDE_BIT = 0x80000000u;
+
+static float surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+  glm::vec3 extent = glm::max(max - min, glm::vec3(0.0f));
+  return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+void Bvh::build(const std::vector<Bounds>& bounds) {
+  std::vector<unsigned int> primitives(bounds.size());
+  for (unsigned int i = 0; i < primitives.size(); i++) {
+    primitives[i] = i;
+  }
+  slotOf_.assign(bounds.size(), BVH_INVALID);
+  leafOf_.assign(bounds.size(), BVH_INVALID);
+  buildPrimitives(bounds, std::move(primitives));
+}
+
+void Bvh::rebuild() {
+  std::vector<Bounds> bounds(slotOf_.size());
+  std::vector<unsigned int> primitives;
+  primitives.reserve(primitiveCount_);
+  for (unsigned int slot = 0; slot < primitives_.size(); slot++) {
+    unsigned int primitive = primitives_[slot];
+    if (primitive != BVH_INVALID) {
+      bounds[primitive] = getSlot(slot);
+      primitives.push_back(primitive);
+    }
+  }
+  buildPrimitives(bounds, std::move(primitives));
+}
+
+void Bvh::buildPrimitives(const std::vector<Bounds>& bounds,
+                          std::vector<unsigned int> primitives) {
+  unsigned int count = primitives.size();
+  nodes_.clear();
+  freeNodePairs_.clear();
+  freeSlotBlocks_.clear();
+  primitives_ = std::move(primitives);
+  primitiveCount_ = count;
+  if (count == 0) {
+    resizeSlots(0);
+    return;
+  }
+
+  std::vector<glm::vec3> centroids(bounds.size());
+  for (unsigned int primitive : primitives_) {
+    centroids[primitive] =
+        (bounds[primitive].min + bounds[primitive].max) * 0.5f;
+  }
+
+  // a binary tree with at least one primitive per leaf has < 2n nodes
+  nodes_.reserve(2 * count);
+  nodes_.push_back({glm::vec3(0.0f), 0, glm::vec3(0.0f), BVH_INVALID, 0,
+                    count, 0});
+  subdivide(0, 0, bounds, centroids);
+
+  // lay out the primitive data in slot order
+  slotMin_.resize(count);
+  slotMax_.resize(count);
+  sphereX_.resize(count);
+  sphereY_.resize(count);
+  sphereZ_.resize(count);
+  sphereRadius_.resize(count);
+  for (unsigned int slot = 0; slot < count; slot++) {
+    slotOf_[primitives_[slot]] = slot;
+    setSlot(slot, bounds[primitives_[slot]]);
+  }
+
+  // children always follow their parent, so a reverse sweep is bottom up
+  for (unsigned int i = nodes_.size(); i-- > 0;) {
+    updateNodeBounds(i);
+  }
+}
+
+void Bvh::subdivide(unsigned int node,
+                    unsigned int depth,
+                    const std::vector<Bounds>& bounds,
+                    const std::vector<glm::vec3>& centroids) {
+  unsigned int first = nodes_[node].first;
+  unsigned int count = nodes_[node].count;
+  if (count <= BVH_MAX_LEAF_SIZE) {
+    // no spare slots, the first insert moves the leaf to a full block
+    nodes_[node].capacity = count;
+    for (unsigned int i = first; i < first + count; i++) {
+      leafOf_[primitives_[i]] = node;
+    }
+    return;
+  }
+
+  glm::vec3 centroidMin(std::numeric_limits<float>::max());
+  glm::vec3 centroidMax(-std::numeric_limits<float>::max());
+  for (unsigned int i = first; i < first + count; i++) {
+    centroidMin = glm::min(centroidMin, centroids[primitives_[i]]);
+    centroidMax = glm::max(centroidMax, centroids[primitives_[i]]);
+  }
+
+  // binned SAH: the cost of a split is the area of each side times its
+  // primitive count
+  int bestAxis = -1;
+  unsigned int bestSplit = 0;
+  float bestCost = std::numeric_limits<float>::max();
+  for (int axis = 0; axis < 3 && depth < BVH_SAH_MAX_DEPTH; axis++) {
+    float extent = centroidMax[axis] - centroidMin[axis];
+    if (extent <= 0.0f) {
+      continue;
+    }
+    float scale = BVH_SAH_BINS / extent;
+
+    glm::vec3 binMin[BVH_SAH_BINS];
+    glm::vec3 binMax[BVH_SAH_BINS];
+    unsigned int binCount[BVH_SAH_BINS] = {};
+    for (unsigned int b = 0; b < BVH_SAH_BINS; b++) {
+      binMin[b] = glm::vec3(std::numeric_limits<float>::max());
+      binMax[b] = glm::vec3(-std::numeric_limits<float>::max());
+    }
+    for (unsigned int i = first; i < first + count; i++) {
+      unsigned int primitive = primitives_[i];
+      unsigned int b = std::min(
+          BVH_SAH_BINS - 1,
+          (unsigned int)((centroids[primitive][axis] - centroidMin[axis]) *
+                         scale));
+      binMin[b] = glm::min(binMin[b], bounds[primitive].min);
+      binMax[b] = glm::max(binMax[b], bounds[primitive].max);
+      binCount[b]++;
+    }
+
+    // sweep from the right to get the area of every right side
+    float rightArea[BVH_SAH_BINS];
+    unsigned int rightCount[BVH_SAH_BINS];
+    glm::vec3 sweepMin(std::numeric_limits<float>::max());
+    glm::vec3 sweepMax(-std::numeric_limits<float>::max());
+    unsigned int sweepCount = 0;
+    for (unsigned int b = BVH_SAH_BINS - 1; b > 0; b--) {
+      sweepMin = glm::min(sweepMin, binMin[b]);
+      sweepMax = glm::max(sweepMax, binMax[b]);
+      sweepCount += binCount[b];
+      rightArea[b] = surfaceArea(sweepMin, sweepMax);
+      rightCount[b] = sweepCount;
+    }
+
+    // split b puts bins [0, b) to the left
+    sweepMin = glm::vec3(std::numeric_limits<float>::max());
+    sweepMax = glm::vec3(-std::numeric_limits<float>::max());
+    sweepCount = 0;
+    for (unsigned int b = 1; b < BVH_SAH_BINS; b++) {
+      sweepMin = glm::min(sweepMin, binMin[b - 1]);
+      sweepMax = glm::max(sweepMax, binMax[b - 1]);
+      sweepCount += binCount[b - 1];
+      if (sweepCount == 0 || rightCount[b] == 0) {
+        continue;
+      }
+      float cost = sweepCount * surfaceArea(sweepMin, sweepMax) +
+                   rightCount[b] * rightArea[b];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestAxis = axis;
+        bestSplit = b;
+      }
+    }
+  }
+
+  unsigned int* begin = &primitives_[first];
+  unsigned int* end = begin + count;
+  unsigned int* middle;
+  if (bestAxis >= 0) {
+    float scale =
+        BVH_SAH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+    middle = std::partition(begin, end, [&](unsigned int primitive) {
+      unsigned int b = std::min(
+          BVH_SAH_BINS - 1,
+          (unsigned int)((centroids[primitive][bestAxis] -
+                          centroidMin[bestAxis]) *
+                         scale));
+      return b < bestSplit;
+    });
+  } else {
+    // all centroids coincide or the tree got too deep, split in half
+    middle = begin + count / 2;
+  }
+  unsigned int leftCount = middle - begin;
+
+  unsigned int left = nodes_.size();
+  nodes_[node].left = left;
+  nodes_.push_back(
+      {glm::vec3(0.0f), 0, glm::vec3(0.0f), node, first, leftCount, 0});
+  nodes_.push_back({glm::vec3(0.0f), 0, glm::vec3(0.0f), node,
+                    first + leftCount, count - leftCount, 0});
+  subdivide(left, depth + 1, bounds, centroids);
+  subdivide(left + 1, depth + 1, bounds, centroids);
+}
+
+void Bvh::insert(unsigned int primitive, const Bounds& bounds) {
+  if (primitive >= slotOf_.size()) {
+    slotOf_.resize(primitive + 1, BVH_INVALID);
+    leafOf_.resize(primitive + 1, BVH_INVALID);
+  }
+  if (slotOf_[primitive] != BVH_INVALID) {
+    refit(primitive, bounds);
+    return;
+  }
+  if (nodes_.empty()) {
+    unsigned int first = allocateSlots();
+    nodes_.push_back({glm::vec3(0.0f), 0, glm::vec3(0.0f), BVH_INVALID,
+                      first, 0, BVH_MAX_LEAF_SIZE});
+  }
+
+  // descend to the child whose box grows least, a cheap stand-in for the
+  // SAH cost of the insert
+  unsigned int node = 0;
+  unsigned int depth = 0;
+  while (nodes_[node].left != 0) {
+    unsigned int left = nodes_[node].left;
+    const BvhNode& a = nodes_[left];
+    const BvhNode& b = nodes_[left + 1];
+    float growA = surfaceArea(glm::min(a.min, bounds.min),
+                              glm::max(a.max, bounds.max)) -
+                  surfaceArea(a.min, a.max);
+    float growB = surfaceArea(glm::min(b.min, bounds.min),
+                              glm::max(b.max, bounds.max)) -
+                  surfaceArea(b.min, b.max);
+    node = growA < growB || (growA == growB && a.count <= b.count)
+               ? left
+               : left + 1;
+    depth++;
+  }
+
+  if (nodes_[node].count == nodes_[node].capacity) {
+    if (nodes_[node].capacity < BVH_MAX_LEAF_SIZE) {
+      relocateLeaf(node);
+    } else {
+      // both halves of the split have room, take the one growing least
+      unsigned int left = splitLeaf(node);
+      float growA =
+          surfaceArea(glm::min(nodes_[left].min, bounds.min),
+                      glm::max(nodes_[left].max, bounds.max)) -
+          surfaceArea(nodes_[left].min, nodes_[left].max);
+      float growB =
+          surfaceArea(glm::min(nodes_[left + 1].min, bounds.min),
+                      glm::max(nodes_[left + 1].max, bounds.max)) -
+          surfaceArea(nodes_[left + 1].min, nodes_[left + 1].max);
+      node = growA <= growB ? left : left + 1;
+      depth++;
+    }
+  }
+
+  BvhNode& leaf = nodes_[node];
+  unsigned int slot = leaf.first + leaf.count;
+  leaf.count++;
+  setSlot(slot, bounds);
+  primitives_[slot] = primitive;
+  slotOf_[primitive] = slot;
+  leafOf_[primitive] = node;
+  primitiveCount_++;
+
+  updateNodeBounds(node);
+  updateAncestors(leaf.parent, 1);
+  if (depth > BVH_MAX_DEPTH) {
+    rebuild();
+  }
+}
+
+bool Bvh::remove(unsigned int primitive) {
+  if (primitive >= slotOf_.size() || slotOf_[primitive] == BVH_INVALID) {
+    return false;
+  }
+  unsigned int node = leafOf_[primitive];
+  BvhNode& leaf = nodes_[node];
+
+  // the leaf's last slot fills the gap
+  unsigned int last = leaf.first + leaf.count - 1;
+  if (slotOf_[primitive] != last) {
+    moveSlot(last, slotOf_[primitive]);
+  }
+  primitives_[last] = BVH_INVALID;
+  leaf.count--;
+  slotOf_[primitive] = BVH_INVALID;
+  leafOf_[primitive] = BVH_INVALID;
+  primitiveCount_--;
+
+  if (leaf.count > 0 || node == 0) {
+    updateNodeBounds(node);
+    updateAncestors(leaf.parent, -1);
+    return true;
+  }
+
+  // the sibling of the empty leaf takes the place of their parent
+  unsigned int parent = leaf.parent;
+  unsigned int pair = nodes_[parent].left;
+  unsigned int sibling = node == pair ? pair + 1 : pair;
+  if (leaf.capacity == BVH_MAX_LEAF_SIZE) {
+    freeSlotBlocks_.push_back(leaf.first);
+  }
+  BvhNode moved = nodes_[sibling];
+  moved.parent = nodes_[parent].parent;
+  nodes_[parent] = moved;
+  if (moved.left != 0) {
+    nodes_[moved.left].parent = parent;
+    nodes_[moved.left + 1].parent = parent;
+  } else {
+    for (unsigned int slot = moved.first; slot < moved.first + moved.count;
+         slot++) {
+      leafOf_[primitives_[slot]] = parent;
+    }
+  }
+  freeNodePairs_.push_back(pair);
+  updateAncestors(moved.parent, -1);
+  return true;
+}
+
+void Bvh::rename(unsigned int from, unsigned int to) {
+  if (from >= slotOf_.size() || slotOf_[from] == BVH_INVALID) {
+    return;
+  }
+  if (to >= slotOf_.size()) {
+    slotOf_.resize(to + 1, BVH_INVALID);
+    leafOf_.resize(to + 1, BVH_INVALID);
+  }
+  slotOf_[to] = slotOf_[from];
+  leafOf_[to] = leafOf_[from];
+  primitives_[slotOf_[to]] = to;
+  slotOf_[from] = BVH_INVALID;
+  leafOf_[from] = BVH_INVALID;
+}
+
+void Bvh::updateAncestors(unsigned int node, int delta) {
+  for (; node != BVH_INVALID; node = nodes_[node].parent) {
+    nodes_[node].count += delta;
+    nodes_[node].first = BVH_INVALID;
+    updateNodeBounds(node);
+  }
+}
+
+unsigned int Bvh::splitLeaf(unsigned int node) {
+  unsigned int first = nodes_[node].first;
+  unsigned int count = nodes_[node].count;
+
+  Bounds bounds[BVH_MAX_LEAF_SIZE];
+  unsigned int primitives[BVH_MAX_LEAF_SIZE];
+  glm::vec3 centroids[BVH_MAX_LEAF_SIZE];
+  glm::vec3 centroidMin(std::numeric_limits<float>::max());
+  glm::vec3 centroidMax(-std::numeric_limits<float>::max());
+  unsigned int order[BVH_MAX_LEAF_SIZE];
+  for (unsigned int i = 0; i < count; i++) {
+    bounds[i] = getSlot(first + i);
+    primitives[i] = primitives_[first + i];
+    centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+    centroidMin = glm::min(centroidMin, centroids[i]);
+    centroidMax = glm::max(centroidMax, centroids[i]);
+    order[i] = i;
+  }
+  glm::vec3 extent = centroidMax - centroidMin;
+  int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                 : (extent.y > extent.z ? 1 : 2);
+  std::sort(order, order + count, [&](unsigned int a, unsigned int b) {
+    return centroids[a][axis] < centroids[b][axis];
+  });
+
+  // the left child keeps the block of the leaf
+  unsigned int rightFirst = allocateSlots();
+  unsigned int left = allocateNodePair();
+  unsigned int leftCount = count / 2;
+  nodes_[left] = {glm::vec3(0.0f), 0, glm::vec3(0.0f), node, first,
+                  leftCount, BVH_MAX_LEAF_SIZE};
+  nodes_[left + 1] = {glm::vec3(0.0f), 0, glm::vec3(0.0f), node, rightFirst,
+                      count - leftCount, BVH_MAX_LEAF_SIZE};
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int slot =
+        i < leftCount ? first + i : rightFirst + i - leftCount;
+    unsigned int primitive = primitives[order[i]];
+    setSlot(slot, bounds[order[i]]);
+    primitives_[slot] = primitive;
+    slotOf_[primitive] = slot;
+    leafOf_[primitive] = i < leftCount ? left : left + 1;
+  }
+  for (unsigned int slot = first + leftCount; slot < first + count; slot++) {
+    primitives_[slot] = BVH_INVALID;
+  }
+  updateNodeBounds(left);
+  updateNodeBounds(left + 1);
+
+  BvhNode& inner = nodes_[node];
+  inner.left = left;
+  inner.first = BVH_INVALID;
+  inner.capacity = 0;
+  return left;
+}
+
+void Bvh::relocateLeaf(unsigned int node) {
+  unsigned int first = allocateSlots();
+  BvhNode& leaf = nodes_[node];
+  for (unsigned int i = 0; i < leaf.count; i++) {
+    moveSlot(leaf.first + i, first + i);
+    primitives_[leaf.first + i] = BVH_INVALID;
+  }
+  // the old slots stay unused until the next build
+  leaf.first = first;
+  leaf.capacity = BVH_MAX_LEAF_SIZE;
+}
+
+unsigned int Bvh::allocateSlots() {
+  if (!freeSlotBlocks_.empty()) {
+    unsigned int first = freeSlotBlocks_.back();
+    freeSlotBlocks_.pop_back();
+    return first;
+  }
+  unsigned int first = primitives_.size();
+  resizeSlots(first + BVH_MAX_LEAF_SIZE);
+  return first;
+}
+
+unsigned int Bvh::allocateNodePair() {
+  if (!freeNodePairs_.empty()) {
+    unsigned int left = freeNodePairs_.back();
+    freeNodePairs_.pop_back();
+    return left;
+  }
+  unsigned int left = nodes_.size();
+  nodes_.resize(left + 2);
+  return left;
+}
+
+void Bvh::refit(unsigned int primitive, const Bounds& bounds) {
+  if (primitive >= slotOf_.size() || slotOf_[primitive] == BVH_INVALID) {
+    return;
+  }
+  setSlot(slotOf_[primitive], bounds);
+
+  unsigned int node = leafOf_[primitive];
+  while (node != BVH_INVALID && updateNodeBounds(node)) {
+    node = nodes_[node].parent;
+  }
+}
+
+bool Bvh::updateNodeBounds(unsigned int node) {
+  BvhNode& n = nodes_[node];
+  glm::vec3 min(std::numeric_limits<float>::max());
+  glm::vec3 max(-std::numeric_limits<float>::max());
+  if (n.left == 0) {
+    for (unsigned int slot = n.first; slot < n.first + n.count; slot++) {
+      min = glm::min(min, slotMin_[slot]);
+      max = glm::max(max, slotMax_[slot]);
+    }
+  } else {
+    min = glm::min(nodes_[n.left].min, nodes_[n.left + 1].min);
+    max = glm::max(nodes_[n.left].max, nodes_[n.left + 1].max);
+  }
+  if (min == n.min && max == n.max) {
+    return false;
+  }
+  n.min = min;
+  n.max = max;
+  return true;
+}
+
+void Bvh::setSlot(unsigned int slot, const Bounds& bounds) {
+  slotMin_[slot] = bounds.min;
+  slotMax_[slot] = bounds.max;
+  sphereX_[slot] = bounds.center.x;
+  sphereY_[slot] = bounds.center.y;
+  sphereZ_[slot] = bounds.center.z;
+  sphereRadius_[slot] = bounds.radius;
+}
+
+Bounds Bvh::getSlot(unsigned int slot) const {
+  Bounds bounds;
+  bounds.min = slotMin_[slot];
+  bounds.max = slotMax_[slot];
+  bounds.center = glm::vec3(sphereX_[slot], sphereY_[slot], sphereZ_[slot]);
+  bounds.radius = sphereRadius_[slot];
+  return bounds;
+}
+
+void Bvh::moveSlot(unsigned int from, unsigned int to) {
+  setSlot(to, getSlot(from));
+  primitives_[to] = primitives_[from];
+  slotOf_[primitives_[to]] = to;
+}
+
+void Bvh::resizeSlots(unsigned int count) {
+  primitives_.resize(count, BVH_INVALID);
+  slotMin_.resize(count);
+  slotMax_.resize(count);
+  sphereX_.resize(count);
+  sphereY_.resize(count);
+  sphereZ_.resize(count);
+  sphereRadius_.resize(count);
+}
+
+void Bvh::cull(const Frustum& frustum,
+               std::vector<unsigned int>& visible) const {
+  if (nodes_.empty()) {
+    return;
+  }
+
+  unsigned int stack[STACK_SIZE];
+  unsigned int stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0) {
+    unsigned int entry = stack[--stackSize];
+    const BvhNode& node = nodes_[entry & ~STACK_INSIDE_BIT];
+    FrustumResult result = (entry & STACK_INSIDE_BIT)
+                               ? FRUSTUM_INSIDE
+                               : frustum.classifyBox(node.min, node.max);
+    if (result == FRUSTUM_OUTSIDE) {
+      continue;
+    }
+    if (result == FRUSTUM_INSIDE) {
+      if (node.first != BVH_INVALID) {
+        visible.insert(visible.end(), primitives_.begin() + node.first,
+                       primitives_.begin() + node.first + node.count);
+      } else {
+        // slots scattered by incremental updates, accept leaf by leaf
+        stack[stackSize++] = node.left | STACK_INSIDE_BIT;
+        stack[stackSize++] = (node.left + 1) | STACK_INSIDE_BIT;
+      }
+      continue;
+    }
+    if (node.left == 0) {
+      uint8_t inside[BVH_MAX_LEAF_SIZE];
+      frustum.cullSpheres(&sphereX_[node.first], &sphereY_[node.first],
+                          &sphereZ_[node.first], &sphereRadius_[node.first],
+                          node.count, inside);
+      for (unsigned int i = 0; i < node.count; i++) {
+        if (inside[i]) {
+          visible.push_back(primitives_[node.first + i]);
+        }
+      }
+      continue;
+    }
+    stack[stackSize++] = node.left;
+    stack[stackSize++] = node.left + 1;
+  }
+}
+
+/**
+ * @brief Slab test of a ray against a box
+ *
+ * @param min
+ * @param max
+ * @param origin
+ * @param invDirection 1 / ray direction
+ * @param maxDistance
+ * @return float entry distance, infinity if the box is missed
+ */
+static float intersectRayBox(const glm::vec3& min,
+                             const glm::vec3& max,
+                             const glm::vec3& origin,
+                             const glm::vec3& invDirection,
+                             float maxDistance) {
+  glm::vec3 t0 = (min - origin) * invDirection;
+  glm::vec3 t1 = (max - origin) * invDirection;
+  glm::vec3 tMin = glm::min(t0, t1);
+  glm::vec3 tMax = glm::max(t0, t1);
+  float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+  float exit =
+      std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+  if (enter > exit) {
+    return std::numeric_limits<float>::infinity();
+  }
+  return enter;
+}
+
+bool Bvh::raycast(const glm::vec3& origin,
+                  const glm::vec3& direction,
+                  float maxDistance,
+                  BvhRayHit& hit) const {
+  if (nodes_.empty()) {
+    return false;
+  }
+
+  glm::vec3 invDirection = 1.0f / direction;
+  hit.primitive = BVH_INVALID;
+  hit.distance = maxDistance;
+
+  unsigned int stack[STACK_SIZE];
+  unsigned int stackSize = 0;
+  if (intersectRayBox(nodes_[0].min, nodes_[0].max, origin, invDirection,
+                      hit.distance) <= hit.distance) {
+    stack[stackSize++] = 0;
+  }
+  while (stackSize > 0) {
+    const BvhNode& node = nodes_[stack[--stackSize]];
+    if (node.left == 0) {
+      for (unsigned int slot = node.first; slot < node.first + node.count;
+           slot++) {
+        float distance = intersectRayBox(slotMin_[slot], slotMax_[slot],
+                                         origin, invDirection, hit.distance);
+        if (distance < hit.distance) {
+          hit.distance = distance;
+          hit.primitive = primitives_[slot];
+        }
+      }
+      continue;
+    }
+
+    // visit the nearer child first, pruning the other one by the closest
+    // hit found so far
+    unsigned int closer = node.left;
+    unsigned int further = node.left + 1;
+    float closerDistance =
+        intersectRayBox(nodes_[closer].min, nodes_[closer].max, origin,
+                        invDirection, hit.distance);
+    float furtherDistance =
+        intersectRayBox(nodes_[further].min, nodes_[further].max, origin,
+                        invDirection, hit.distance);
+    if (furtherDistance < closerDistance) {
+      std::swap(closer, further);
+      std::swap(closerDistance, furtherDistance);
+    }
+    if (furtherDistance <= hit.distance) {
+      stack[stackSize++] = further;
+    }
+    if (closerDistance <= hit.distance) {
+      stack[stackSize++] = closer;
+    }
+  }
+  return hit.primitive != BVH_INVALID;
+}
@@ -0,0 +1,286 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "bounds.hpp"
+#include "frustum.hpp"
+
+// most primitives stored in one leaf, one SSE sphere test per leaf. Leaves
+// created by `Bvh::insert()` reserve this many slots.
+constexpr unsigned int BVH_MAX_LEAF_SIZE = 4;
+// number of centroid bins evaluated per axis by the SAH build
+constexpr unsigned int BVH_SAH_BINS = 12;
+// deeper nodes are split at the median instead of by SAH, which bounds the
+// depth (and the traversal stacks) to 32 + log2(primitive count)
+constexpr unsigned int BVH_SAH_MAX_DEPTH = 32;
+// an insert creating a deeper leaf rebuilds the tree, which keeps the
+// traversal stacks bounded under incremental updates
+constexpr unsigned int BVH_MAX_DEPTH = 64;
+// parent index of the root node
+constexpr unsigned int BVH_INVALID = 0xffffffff;
+
+/**
+ * @brief Node of a `Bvh`, stored in a flat array.
+ *
+ * Children are allocated next to each other, the right child is at
+ * `left + 1`. After a build every node covers a contiguous range of the
+ * primitive slots, so a whole subtree can be accepted without visiting its
+ * leaves. Inner nodes changed by an insert or remove lose their range and
+ * are accepted by walking their children.
+ */
+struct BvhNode {
+  glm::vec3 min;
+  // index of the left child, 0 for leaves (the root is never a child)
+  unsigned int left;
+  glm::vec3 max;
+  unsigned int parent;
+  // first primitive slot, `BVH_INVALID` for inner nodes whose slots are no
+  // longer contiguous
+  unsigned int first;
+  // leaves: used slots, inner nodes: primitives in the subtree
+  unsigned int count;
+  // leaves: slots reserved at `first`, unused by inner nodes
+  unsigned int capacity;
+};
+
+// closest primitive found by `Bvh::raycast()`
+struct BvhRayHit {
+  unsigned int primitive;
+  float distance;
+};
+
+/**
+ * @brief Bounding volume hierarchy over primitive bounds (e.g. the world
+ * bounds of scene entities).
+ *
+ * Built top down with a binned surface area heuristic. Moving primitives
+ * are handled by refitting the boxes on the path to the root. Primitives
+ * can be inserted (descending to the child whose area grows least) and
+ * removed (collapsing empty leaves into their sibling) in O(depth). All of
+ * these keep the tree valid but can lower its quality, rebuild after large
+ * changes.
+ */
+class Bvh {
+ public:
+  /**
+   * @brief Builds the hierarchy, primitive `i` has the bounds `bounds[i]`
+   *
+   * @param bounds
+   */
+  void build(const std::vector<Bounds>& bounds);
+
+  /**
+   * @brief Builds the hierarchy again over the primitives it holds,
+   * restoring the quality lost by incremental updates
+   *
+   */
+  void rebuild();
+
+  /**
+   * @brief Adds a primitive, refits it if it is already in the hierarchy
+   *
+   * @param primitive id, need not be contiguous with the other ids
+   * @param bounds
+   */
+  void insert(unsigned int primitive, const Bounds& bounds);
+
+  /**
+   * @brief Removes a primitive
+   *
+   * @param primitive
+   * @return false if the primitive was not in the hierarchy
+   */
+  bool remove(unsigned int primitive);
+
+  /**
+   * @brief Changes the id of a primitive, e.g. after the owner of the ids
+   * moved an entry with swap-and-pop
+   *
+   * @param from id in the hierarchy
+   * @param to id not in the hierarchy
+   */
+  void rename(unsigned int from, unsigned int to);
+
+  /**
+   * @brief Updates the bounds of one primitive and refits the boxes of its
+   * leaf and all ancestors
+   *
+   * @param primitive
+   * @param bounds
+   */
+  void refit(unsigned int primitive, const Bounds& bounds);
+
+  /**
+   * @brief Appends the primitives intersecting `frustum` to `visible`.
+   *
+   * Nodes fully inside the frustum are accepted without testing their
+   * children, the primitives of intersecting leaves are tested by their
+   * bounding spheres.
+   *
+   * @param frustum
+   * @param visible
+   */
+  void cull(const Frustum& frustum, std::vector<unsigned int>& visible) const;
+
+  /**
+   * @brief Finds the closest primitive box hit by a ray
+   *
+   * @param origin
+   * @param direction normalized
+   * @param maxDistance
+   * @param hit set to the closest hit, if any
+   * @return true if a primitive was hit within `maxDistance`
+   */
+  bool raycast(const glm::vec3& origin,
+               const glm::vec3& direction,
+               float maxDistance,
+               BvhRayHit& hit) const;
+
+  /**
+   * @brief Get the number of primitives in the hierarchy
+   *
+   * @return unsigned int
+   */
+  unsigned int size() const { return primitiveCount_; }
+
+  /**
+   * @brief Get the number of nodes in use
+   *
+   * @return unsigned int
+   */
+  unsigned int getNodeCount() const {
+    return nodes_.size() - 2 * freeNodePairs_.size();
+  }
+
+ private:
+  std::vector<BvhNode> nodes_;
+  // left child index of node pairs freed by `remove()`
+  std::vector<unsigned int> freeNodePairs_;
+  unsigned int primitiveCount_ = 0;
+
+  // per slot: primitive id (`BVH_INVALID` if unused) and its bounds, leaves
+  // cover ranges of slots
+  std::vector<unsigned int> primitives_;
+  std::vector<glm::vec3> slotMin_;
+  std::vector<glm::vec3> slotMax_;
+  // bounding spheres per slot (SoA) for `Frustum::cullSpheres()`
+  std::vector<float> sphereX_;
+  std::vector<float> sphereY_;
+  std::vector<float> sphereZ_;
+  std::vector<float> sphereRadius_;
+  // first slots of `BVH_MAX_LEAF_SIZE` blocks freed by `remove()`
+  std::vector<unsigned int> freeSlotBlocks_;
+
+  // per primitive id: its slot and the leaf containing it, `BVH_INVALID`
+  // for ids not in the hierarchy
+  std::vector<unsigned int> slotOf_;
+  std::vector<unsigned int> leafOf_;
+
+  /**
+   * @brief Builds the hierarchy over `primitives`
+   *
+   * @param bounds indexed by primitive id
+   * @param primitives ids to insert, `slotOf_` and `leafOf_` must cover
+   * them
+   */
+  void buildPrimitives(const std::vector<Bounds>& bounds,
+                       std::vector<unsigned int> primitives);
+
+  /**
+   * @brief Recursively splits `node` until its leaves hold at most
+   * `BVH_MAX_LEAF_SIZE` primitives
+   *
+   * @param node
+   * @param depth of `node`, the root is at 0
+   * @param bounds primitive bounds by id
+   * @param centroids primitive box centers by id
+   */
+  void subdivide(unsigned int node,
+                 unsigned int depth,
+                 const std::vector<Bounds>& bounds,
+                 const std::vector<glm::vec3>& centroids);
+
+  /**
+   * @brief Recomputes the box of `node` from its slots (leaves) or children
+   *
+   * @param node
+   * @return true if the box changed
+   */
+  bool updateNodeBounds(unsigned int node);
+
+  /**
+   * @brief Recomputes the boxes from `node` up to the root and adds `delta`
+   * to the primitive count of the inner nodes on the way, which no longer
+   * cover a contiguous slot range
+   *
+   * @param node
+   * @param delta
+   */
+  void updateAncestors(unsigned int node, int delta);
+
+  /**
+   * @brief Splits a full leaf in two at the median of its centroids along
+   * the widest axis
+   *
+   * @param node
+   * @return unsigned int index of the new left child
+   */
+  unsigned int splitLeaf(unsigned int node);
+
+  /**
+   * @brief Moves a leaf into a block of `BVH_MAX_LEAF_SIZE` slots, used for
+   * leaves of a build that have no spare slot
+   *
+   * @param node
+   */
+  void relocateLeaf(unsigned int node);
+
+  /**
+   * @brief Get a free block of `BVH_MAX_LEAF_SIZE` unused slots
+   *
+   * @return unsigned int first slot
+   */
+  unsigned int allocateSlots();
+
+  /**
+   * @brief Get two free adjacent nodes
+   *
+   * @return unsigned int index of the first one
+   */
+  unsigned int allocateNodePair();
+
+  /**
+   * @brief Copies `bounds` into the slot arrays
+   *
+   * @param slot
+   * @param bounds
+   */
+  void setSlot(unsigned int slot, const Bounds& bounds);
+
+  /**
+   * @brief Get the bounds stored in a slot
+   *
+   * @param slot
+   * @return Bounds
+   */
+  Bounds getSlot(unsigned int slot) const;
+
+  /**
+   * @brief Moves primitive and bounds of slot `from` to slot `to`
+   *
+   * @param from
+   * @param to
+   */
+  void moveSlot(unsigned int from, unsigned int to);
+
+  /**
+   * @brief Resizes all slot arrays, new slots are unused
+   *
+   * @param count
+   */
+  void resizeSlots(unsigned int count);
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "scene/bvh_benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "camera.hpp"
+#include "scene/bvh.hpp"
+
+// repetitions each timing is averaged over
+static const int ITERATIONS = 50;
+static const int RAY_COUNT = 1000;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+/**
+ * @brief Linear reference for `Bvh::raycast()`
+ *
+ * @param bounds
+ * @param origin
+ * @param direction
+ * @return unsigned int index of the closest box hit, BVH_INVALID if none
+ */
+static unsigned int raycastLinear(const std::vector<Bounds>& bounds,
+                                  const glm::vec3& origin,
+                                  const glm::vec3& direction) {
+  glm::vec3 invDirection = 1.0f / direction;
+  unsigned int closest = BVH_INVALID;
+  float closestDistance = std::numeric_limits<float>::max();
+  for (unsigned int i = 0; i < bounds.size(); i++) {
+    glm::vec3 t0 = (bounds[i].min - origin) * invDirection;
+    glm::vec3 t1 = (bounds[i].max - origin) * invDirection;
+    glm::vec3 tMin = glm::min(t0, t1);
+    glm::vec3 tMax = glm::max(t0, t1);
+    float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+    float exit = std::min(std::min(tMax.x, tMax.y),
+                          std::min(tMax.z, closestDistance));
+    if (enter <= exit) {
+      closest = i;
+      closestDistance = enter;
+    }
+  }
+  return closest;
+}
+
+static void benchmark(unsigned int count, std::mt19937& rng) {
+  // keep the density constant, 10 boxes per 1000 cubic units
+  float halfSize = 0.5f * std::cbrt(count * 100.0f);
+  std::uniform_real_distribution<float> position(-halfSize, halfSize);
+  std::uniform_real_distribution<float> size(0.5f, 2.0f);
+
+  std::vector<Bounds> bounds(count);
+  std::vector<float> x(count), y(count), z(count), radius(count);
+  for (unsigned int i = 0; i < count; i++) {
+    glm::vec3 center(position(rng), position(rng), position(rng));
+    glm::vec3 extent(size(rng), size(rng), size(rng));
+    glm::vec3 corners[2] = {center - extent * 0.5f, center + extent * 0.5f};
+    bounds[i] = makeBounds(corners, 2, sizeof(glm::vec3));
+    x[i] = bounds[i].center.x;
+    y[i] = bounds[i].center.y;
+    z[i] = bounds[i].center.z;
+    radius[i] = bounds[i].radius;
+  }
+
+  // default camera at the center of the boxes
+  glm::mat4 projection = glm::perspective(glm::radians(FOV), 1.5f,
+                                          NEAR_PLANE, FAR_PLANE);
+  glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+                               glm::vec3(0.0f, 1.0f, 0.0f));
+  Frustum frustum(projection * view);
+
+  Clock::time_point start = Clock::now();
+  Bvh bvh;
+  bvh.build(bounds);
+  double buildMs = elapsedMs(start);
+
+  // linear scan over the SoA spheres. The BVH rejects whole boxes first, so
+  // it may report slightly fewer visible boxes.
+  std::vector<uint8_t> visible(count);
+  size_t linearVisible = 0;
+  start = Clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    linearVisible = frustum.cullSpheres(x.data(), y.data(), z.data(),
+                                        radius.data(), count, visible.data());
+  }
+  double linearCullMs = elapsedMs(start) / ITERATIONS;
+
+  std::vector<unsigned int> bvhVisible;
+  bvhVisible.reserve(count);
+  start = Clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    bvhVisible.clear();
+    bvh.cull(frustum, bvhVisible);
+  }
+  double bvhCullMs = elapsedMs(start) / ITERATIONS;
+
+  // rays from the center in random directions
+  std::normal_distribution<float> normal;
+  std::vector<glm::vec3> directions(RAY_COUNT);
+  for (glm::vec3& direction : directions) {
+    direction =
+        glm::normalize(glm::vec3(normal(rng), normal(rng), normal(rng)));
+  }
+
+  unsigned int linearHits = 0;
+  start = Clock::now();
+  for (const glm::vec3& direction : directions) {
+    linearHits += raycastLinear(bounds, glm::vec3(0.0f), direction) !=
+                  BVH_INVALID;
+  }
+  double linearRayMs = elapsedMs(start);
+
+  unsigned int bvhHits = 0;
+  start = Clock::now();
+  for (const glm::vec3& direction : directions) {
+    BvhRayHit hit;
+    bvhHits += bvh.raycast(glm::vec3(0.0f), direction,
+                           std::numeric_limits<float>::max(), hit);
+  }
+  double bvhRayMs = elapsedMs(start);
+
+  // move 1% of the boxes and refit
+  unsigned int moved = std::max(1u, count / 100);
+  start = Clock::now();
+  for (unsigned int i = 0; i < moved; i++) {
+    Bounds b = bounds[i];
+    b.min.x += 1.0f;
+    b.max.x += 1.0f;
+    b.center.x += 1.0f;
+    bvh.refit(i, b);
+  }
+  double refitMs = elapsedMs(start);
+
+  // remove 1% of the boxes and insert them again
+  start = Clock::now();
+  for (unsigned int i = 0; i < moved; i++) {
+    bvh.remove(i);
+  }
+  for (unsigned int i = 0; i < moved; i++) {
+    bvh.insert(i, bounds[i]);
+  }
+  double churnMs = elapsedMs(start);
+
+  std::cout << std::setw(8) << count << std::fixed << std::setprecision(3)
+            << " | build " << std::setw(8) << buildMs << " ms"
+            << " | cull linear " << std::setw(7) << linearCullMs << " ms, bvh "
+            << std::setw(7) << bvhCullMs << " ms (" << linearVisible << "/"
+            << bvhVisible.size() << " visible)"
+            << " | " << RAY_COUNT << " rays linear " << std::setw(8)
+            << linearRayMs << " ms, bvh " << std::setw(7) << bvhRayMs
+            << " ms (" << linearHits << "/" << bvhHits << " hits)"
+            << " | refit " << moved << ": " << refitMs << " ms"
+            << " | remove + insert " << moved << ": " << churnMs << " ms"
+            << std::endl;
+}
+
+void runBvhBenchmark() {
+  std::mt19937 rng(1234);
+  std::cout << "BVH::BENCHMARK linear scan vs. BVH, " << ITERATIONS
+            << " culling iterations" << std::endl;
+  for (unsigned int count : {1000u, 10000u, 100000u}) {
+    benchmark(count, rng);
+  }
+}
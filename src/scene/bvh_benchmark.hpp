@@ -0,0 +1,12 @@
+#ifndef BVH_BENCHMARK_H
+#define BVH_BENCHMARK_H
+
+/**
+ * @brief Compares frustum culling and ray queries over 1k/10k/100k random
+ * boxes, linear scan vs. `Bvh`, and prints the timings.
+ *
+ * Runs on the CPU only, start the renderer with `--bench-bvh`.
+ */
+void runBvhBenchmark();
+
+#endif
@@ -1,30 +1,41 @@
 #include "scene/entitiy.hpp"
 
-MeshEntity::MeshEntity(std::shared_ptr<Mesh> mesh, Transform transform)
-    : Entity(transform), mesh_(std::move(mesh)) {
-  useColor_ = false;
-};
-
-MeshEntity::MeshEntity(std::shared_ptr<Mesh> mesh,
-                       Transform transform,
-                       glm::vec3 color)
-    : Entity(transform), mesh_(std::move(mesh)), color_(color) {
-  useColor_ = true;
-};
-
-void MeshEntity::draw(Shader& shader) const {
-  shader.setMat4("model", transform_.getModelMatrix());
-  if (useColor_) {
-    mesh_->draw(shader, color_);
-  } else {
-    mesh_->draw(shader);
-  }
-}
-
-ModelEntity::ModelEntity(std::shared_ptr<Model> model, Transform transform)
-    : Entity(transform), model_(std::move(model)) {};
-
-void ModelEntity::draw(Shader& shader) const {
-  shader.setMat4("model", transform_.getModelMatrix());
-  model_->draw(shader);
-}
\ No newline at end of file
+#include "scene/scene.hpp"
+
+bool Entity::isValid() const {
+  return scene_->isValid(handle_);
+}
+
+unsigned int Entity::index() const {
+  return scene_->entities_.indexOf(handle_);
+}
+
+const Transform& Entity::getTransform() const {
+  return scene_->entities_.transforms_[index()];
+}
+
+void Entity::setTransform(const Transform& transform) {
+  scene_->setTransform(handle_, transform);
+}
+
+glm::mat4 Entity::getWorldMatrix() const {
+  return scene_->getWorldMatrix(handle_);
+}
+
+const std::shared_ptr<Mesh>& MeshEntity::getMesh() const {
+  return scene_->entities_.meshes_[index()];
+}
+
+const glm::vec3& MeshEntity::getColor() const {
+  return scene_->entities_.colors_[index()];
+}
+
+void MeshEntity::setColor(const glm::vec3& color) {
+  unsigned int id = index();
+  scene_->entities_.colors_[id] = color;
+  scene_->entities_.useColor_[id] = 1;
+}
+
+const std::shared_ptr<Model>& ModelEntity::getModel() const {
+  return scene_->entities_.models_[index()];
+}
@@ -1,50 +1,103 @@
 #ifndef ENTITY_H
 #define ENTITY_H
 
+#include <glm/glm.hpp>
 #include <memory>
-#include <vector>
+
+#include "bounds.hpp"
 #include "scene/mesh.hpp"
+#include "scene/entity_store.hpp"
 #include "scene/model.hpp"
 #include "scene/transform.hpp"
-#include "shader.hpp"
 
+class Scene;
+
+/**
+ * @brief Handle to an entity of a `Scene`.
+ *
+ * The entity's components live in the scene's `EntityStore`, the handle
+ * only stores a generational `EntityHandle`. Handles are cheap to copy.
+ * Once the entity is removed `isValid()` returns false, the other accessors
+ * must not be called anymore.
+ */
 class Entity {
  public:
-  Transform transform_;
-  Entity(Transform transform) : transform_(transform) {};
-  virtual ~Entity() = default;
-  virtual void draw(Shader& shader) const = 0;
-};
+  Entity(Scene* scene, EntityHandle handle) : scene_(scene), handle_(handle) {};
 
-class MeshEntity : public Entity {
- public:
-  std::shared_ptr<Mesh> mesh_;
-  // in case of mono colored Mesh, this will be used
-  bool useColor_;
-  glm::vec3 color_;
+  /**
+   * @brief Get the handle identifying the entity in its Scene
+   *
+   * @return EntityHandle
+   */
+  EntityHandle getHandle() const { return handle_; }
+
+  /**
+   * @brief Check if the entity still exists
+   *
+   * @return bool
+   */
+  bool isValid() const;
 
-  MeshEntity() = default;
+  /**
+   * @brief Get the transform relative to the parent entity
+   *
+   * @return const Transform&
+   */
+  const Transform& getTransform() const;
 
-  MeshEntity(std::shared_ptr<Mesh> mesh, Transform transform);
+  /**
+   * @brief Set the transform relative to the parent entity, see
+   * `Scene::setTransform()`
+   *
+   * @param transform
+   */
+  void setTransform(const Transform& transform);
 
-  MeshEntity(std::shared_ptr<Mesh> mesh, Transform transform, glm::vec3 color);
+  /**
+   * @brief Get the world matrix, see `Scene::getWorldMatrix()`
+   *
+   * @return glm::mat4
+   */
+  glm::mat4 getWorldMatrix() const;
 
-  void draw(Shader& shader) const;
+ protected:
+  Scene* scene_;
+  EntityHandle handle_;
 
- private:
+  /**
+   * @brief Get the current index into the `EntityStore` arrays
+   *
+   * @return unsigned int
+   */
+  unsigned int index() const;
 };
 
-class ModelEntity : public Entity {
+class MeshEntity : public Entity {
  public:
-  std::shared_ptr<Model> model_;
+  using Entity::Entity;
+
+  const std::shared_ptr<Mesh>& getMesh() const;
 
-  ModelEntity() = default;
+  /**
+   * @brief Get the color of a mono colored Mesh
+   *
+   * @return const glm::vec3&
+   */
+  const glm::vec3& getColor() const;
 
-  ModelEntity(std::shared_ptr<Model> model, Transform transform);
+  /**
+   * @brief Draw the Mesh mono colored with `color` instead of its textures
+   *
+   * @param color
+   */
+  void setColor(const glm::vec3& color);
+};
 
-  void draw(Shader& shader) const;
+class ModelEntity : public Entity {
+ public:
+  using Entity::Entity;
 
- private:
+  const std::shared_ptr<Model>& getModel() const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,135 @@
+#include "scene/entity_store.hpp"
+
+#include <iostream>
+
+/**
+ * @brief Moves the last element of `v` to `index` and shrinks `v` by one
+ *
+ * @param v
+ * @param index
+ */
+template <typename T>
+static void swapAndPop(std::vector<T>& v, unsigned int index) {
+  if (index != v.size() - 1) {
+    v[index] = std::move(v.back());
+  }
+  v.pop_back();
+}
+
+/**
+ * @brief Removes the first occurrence of `value` from `v`, not preserving
+ * the order
+ *
+ * @param v
+ * @param value
+ */
+static void eraseUnordered(std::vector<unsigned int>& v, unsigned int value) {
+  for (unsigned int i = 0; i < v.size(); i++) {
+    if (v[i] == value) {
+      swapAndPop(v, i);
+      return;
+    }
+  }
+}
+
+EntityHandle EntityStore::addMesh(std::shared_ptr<Mesh> mesh,
+                                  const Transform& transform,
+                                  unsigned int parent) {
+  EntityHandle handle = add(transform, parent, mesh->bounds_);
+  meshes_.push_back(std::move(mesh));
+  models_.push_back(nullptr);
+  return handle;
+}
+
+EntityHandle EntityStore::addModel(std::shared_ptr<Model> model,
+                                   const Transform& transform,
+                                   unsigned int parent) {
+  EntityHandle handle = add(transform, parent, model->getBounds());
+  meshes_.push_back(nullptr);
+  models_.push_back(std::move(model));
+  return handle;
+}
+
+EntityHandle EntityStore::add(const Transform& transform,
+                              unsigned int parent,
+                              const Bounds& localBounds) {
+  unsigned int index = size();
+  if (parent != ENTITY_NO_PARENT && parent >= index) {
+    std::cout << "ERROR::SCENE::INVALID_PARENT: " << parent << std::endl;
+    parent = ENTITY_NO_PARENT;
+  }
+
+  EntityHandle handle;
+  if (freeSlots_.empty()) {
+    handle.index = slots_.size();
+    slots_.push_back({index, 1});
+  } else {
+    handle.index = freeSlots_.back();
+    freeSlots_.pop_back();
+    Slot& slot = slots_[handle.index];
+    slot.dense = index;
+    slot.generation++;
+  }
+  handle.generation = slots_[handle.index].generation;
+
+  transforms_.push_back(transform);
+  localMatrices_.push_back(transform.getModelMatrix());
+  parents_.push_back(parent);
+  children_.emplace_back();
+  if (parent != ENTITY_NO_PARENT) {
+    children_[parent].push_back(index);
+  }
+  colors_.push_back(glm::vec3(1.0f));
+  useColor_.push_back(0);
+  localBounds_.push_back(localBounds);
+  worldBounds_.emplace_back();
+  handles_.push_back(handle);
+  return handle;
+}
+
+void EntityStore::remove(unsigned int index) {
+  if (index >= size()) {
+    return;
+  }
+
+  // detach from the hierarchy
+  if (parents_[index] != ENTITY_NO_PARENT) {
+    eraseUnordered(children_[parents_[index]], index);
+  }
+  for (unsigned int child : children_[index]) {
+    parents_[child] = ENTITY_NO_PARENT;
+  }
+
+  // retire the slot, the generation bump invalidates outstanding handles
+  Slot& slot = slots_[handles_[index].index];
+  slot.generation++;
+  freeSlots_.push_back(handles_[index].index);
+
+  unsigned int last = size() - 1;
+  if (index != last) {
+    // the last entity moves to `index`, redirect everything pointing at it
+    if (parents_[last] != ENTITY_NO_PARENT) {
+      for (unsigned int& child : children_[parents_[last]]) {
+        if (child == last) {
+          child = index;
+        }
+      }
+    }
+    for (unsigned int child : children_[last]) {
+      parents_[child] = index;
+    }
+    slots_[handles_[last].index].dense = index;
+  }
+
+  swapAndPop(transforms_, index);
+  swapAndPop(localMatrices_, index);
+  swapAndPop(parents_, index);
+  swapAndPop(children_, index);
+  swapAndPop(meshes_, index);
+  swapAndPop(models_, index);
+  swapAndPop(colors_, index);
+  swapAndPop(useColor_, index);
+  swapAndPop(localBounds_, index);
+  swapAndPop(worldBounds_, index);
+  swapAndPop(handles_, index);
+}
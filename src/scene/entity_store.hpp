@@ -0,0 +1,163 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "bounds.hpp"
+#include "scene/mesh.hpp"
+#include "scene/model.hpp"
+#include "scene/transform.hpp"
+
+// parent index of root entities in `EntityStore::parents_`
+constexpr unsigned int ENTITY_NO_PARENT = 0xffffffff;
+// returned by `EntityStore::indexOf()` for stale handles
+constexpr unsigned int ENTITY_INVALID = 0xffffffff;
+
+/**
+ * @brief Stable reference to an entity.
+ *
+ * `index` selects a slot of the `EntityStore`, `generation` is bumped every
+ * time the slot's entity is removed, so handles to removed entities are
+ * detected instead of silently pointing at a new entity. A default
+ * constructed handle is never valid.
+ */
+struct EntityHandle {
+  uint32_t index = 0;
+  uint32_t generation = 0;
+
+  bool operator==(const EntityHandle& other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const EntityHandle& other) const {
+    return !(*this == other);
+  }
+};
+
+/**
+ * @brief Per-entity components stored as parallel arrays (SoA), indexed by
+ * a dense entity index.
+ *
+ * Every entity either renders a Mesh or a Model. Loops over one component
+ * touch only that component's array. Write transforms through
+ * `Scene::setTransform()`, which keeps the derived data up to date.
+ *
+ * The dense arrays stay packed: removing an entity moves the last entity
+ * into its place (O(1)). Dense indices therefore change on removal, hold
+ * on to an `EntityHandle` and resolve it with `indexOf()` instead.
+ */
+class EntityStore {
+ public:
+  // relative to the parent
+  std::vector<Transform> transforms_;
+  // cached `Transform::getModelMatrix()`
+  std::vector<glm::mat4> localMatrices_;
+  // dense indices, `ENTITY_NO_PARENT` for roots
+  std::vector<unsigned int> parents_;
+  std::vector<std::vector<unsigned int>> children_;
+
+  // render references, exactly one of both is set per entity
+  std::vector<std::shared_ptr<Mesh>> meshes_;
+  std::vector<std::shared_ptr<Model>> models_;
+  // mono colored meshes, `useColor_` is 0 for textured meshes and models
+  std::vector<glm::vec3> colors_;
+  std::vector<uint8_t> useColor_;
+
+  // object and world space bounds
+  std::vector<Bounds> localBounds_;
+  std::vector<Bounds> worldBounds_;
+
+  // handle of each dense entry
+  std::vector<EntityHandle> handles_;
+
+  /**
+   * @brief Appends an entity rendering `mesh`
+   *
+   * @param mesh
+   * @param transform
+   * @param parent dense index or `ENTITY_NO_PARENT`
+   * @return EntityHandle of the new entity
+   */
+  EntityHandle addMesh(std::shared_ptr<Mesh> mesh,
+                       const Transform& transform,
+                       unsigned int parent);
+
+  /**
+   * @brief Appends an entity rendering `model`
+   *
+   * @param model
+   * @param transform
+   * @param parent dense index or `ENTITY_NO_PARENT`
+   * @return EntityHandle of the new entity
+   */
+  EntityHandle addModel(std::shared_ptr<Model> model,
+                        const Transform& transform,
+                        unsigned int parent);
+
+  /**
+   * @brief Removes one entity by moving the last entity into its place.
+   * Children of the removed entity become roots.
+   *
+   * @param index dense index
+   */
+  void remove(unsigned int index);
+
+  /**
+   * @brief Resolves a handle to the entity's current dense index
+   *
+   * @param handle
+   * @return unsigned int dense index, `ENTITY_INVALID` if the entity was
+   * removed or the handle was never valid
+   */
+  unsigned int indexOf(EntityHandle handle) const {
+    if (handle.index >= slots_.size() ||
+        slots_[handle.index].generation != handle.generation) {
+      return ENTITY_INVALID;
+    }
+    return slots_[handle.index].dense;
+  }
+
+  /**
+   * @brief Check if `handle` refers to a live entity
+   *
+   * @param handle
+   * @return bool
+   */
+  bool isValid(EntityHandle handle) const {
+    return indexOf(handle) != ENTITY_INVALID;
+  }
+
+  /**
+   * @brief Get the number of entities
+   *
+   * @return unsigned int
+   */
+  unsigned int size() const { return transforms_.size(); }
+
+ private:
+  struct Slot {
+    unsigned int dense;
+    // odd while the slot is in use, so the first handle is never {0, 0}
+    uint32_t generation;
+  };
+
+  std::vector<Slot> slots_;
+  // unused slots, reused last in first out
+  std::vector<uint32_t> freeSlots_;
+
+  /**
+   * @brief Appends the components shared by all entities
+   *
+   * @param transform
+   * @param parent
+   * @param localBounds
+   * @return EntityHandle of the new entity
+   */
+  EntityHandle add(const Transform& transform,
+                   unsigned int parent,
+                   const Bounds& localBounds);
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "scene/geometry_buffer.hpp"
+
+#include <algorithm>
+
+#include "gl_state.hpp"
+
+// initial capacities, roughly one small model
+static const unsigned int MIN_VERTEX_CAPACITY = 1 << 16;
+static const unsigned int MIN_INDEX_CAPACITY = 1 << 18;
+
+/**
+ * @brief Creates an immutable buffer of `newSize` bytes, copies the first
+ * `usedSize` bytes of `buffer` into it and deletes the old buffer
+ *
+ * @param buffer
+ * @param usedSize
+ * @param newSize
+ * @return unsigned int the new buffer
+ */
+static unsigned int growBuffer(unsigned int buffer,
+                               size_t usedSize,
+                               size_t newSize) {
+  unsigned int newBuffer;
+  glCreateBuffers(1, &newBuffer);
+  // only written by buffer copies, which need no storage flags
+  glNamedBufferStorage(newBuffer, newSize, nullptr, 0);
+  if (buffer != 0) {
+    if (usedSize > 0) {
+      glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, usedSize);
+    }
+    GlState::deleteBuffer(buffer);
+  }
+  return newBuffer;
+}
+
+GeometryBuffer::GeometryBuffer(VertexFormat format, unsigned int indexType) {
+  VBO = 0;
+  EBO = 0;
+  format_ = format;
+  vertexSize_ = getVertexSize(format);
+  indexType_ = indexType;
+  indexSize_ = getIndexSize(indexType);
+  vertexCount_ = 0;
+  indexCount_ = 0;
+  vertexCapacity_ = 0;
+  indexCapacity_ = 0;
+
+  glCreateVertexArrays(1, &VAO);
+  // separate attribute format, so growing only has to rebind the buffer
+  setupVertexAttributes(VAO, format);
+
+  reserve(MIN_VERTEX_CAPACITY, MIN_INDEX_CAPACITY);
+}
+
+GeometryBuffer::~GeometryBuffer() {
+  GlState::deleteVertexArray(VAO);
+  GlState::deleteBuffer(VBO);
+  GlState::deleteBuffer(EBO);
+}
+
+GeometryRange GeometryBuffer::add(unsigned int vertexBuffer,
+                                  unsigned int vertexCount,
+                                  unsigned int indexBuffer,
+                                  unsigned int indexCount) {
+  // best fit by index capacity, indices make up most of a mesh
+  unsigned int best = freeRanges_.size();
+  for (unsigned int i = 0; i < freeRanges_.size(); i++) {
+    const GeometryRange& free = freeRanges_[i];
+    if (free.vertexCapacity >= vertexCount &&
+        free.indexCapacity >= indexCount &&
+        (best == freeRanges_.size() ||
+         free.indexCapacity < freeRanges_[best].indexCapacity)) {
+      best = i;
+    }
+  }
+
+  GeometryRange range;
+  if (best < freeRanges_.size()) {
+    range = freeRanges_[best];
+    freeRanges_[best] = freeRanges_.back();
+    freeRanges_.pop_back();
+  } else {
+    reserve(vertexCount_ + vertexCount, indexCount_ + indexCount);
+    range = {vertexCount_, indexCount_, 0, vertexCount, indexCount};
+    vertexCount_ += vertexCount;
+    indexCount_ += indexCount;
+  }
+  range.indexCount = indexCount;
+
+  // copies are ordered after the draws already submitted, which may still
+  // read a recycled range
+  glCopyNamedBufferSubData(vertexBuffer, VBO, 0,
+                           range.baseVertex * vertexSize_,
+                           vertexCount * vertexSize_);
+  glCopyNamedBufferSubData(indexBuffer, EBO, 0, range.firstIndex * indexSize_,
+                           indexCount * indexSize_);
+  return range;
+}
+
+void GeometryBuffer::release(const GeometryRange& range) {
+  freeRanges_.push_back(range);
+}
+
+void GeometryBuffer::bind() const {
+  GlState::bindVertexArray(VAO);
+}
+
+void GeometryBuffer::reserve(unsigned int vertexCapacity,
+                             unsigned int indexCapacity) {
+  if (vertexCapacity > vertexCapacity_) {
+    vertexCapacity = std::max(vertexCapacity, vertexCapacity_ * 2);
+    VBO = growBuffer(VBO, vertexCount_ * vertexSize_,
+                     vertexCapacity * vertexSize_);
+    vertexCapacity_ = vertexCapacity;
+    glVertexArrayVertexBuffer(VAO, 0, VBO, 0, vertexSize_);
+  }
+  if (indexCapacity > indexCapacity_) {
+    indexCapacity = std::max(indexCapacity, indexCapacity_ * 2);
+    EBO = growBuffer(EBO, indexCount_ * indexSize_,
+                     indexCapacity * indexSize_);
+    indexCapacity_ = indexCapacity;
+    glVertexArrayElementBuffer(VAO, EBO);
+  }
+}
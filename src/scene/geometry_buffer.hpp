@@ -0,0 +1,110 @@
+#ifndef GEOMETRY_BUFFER_H
+#define GEOMETRY_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "scene/vertex_format.hpp"
+
+// location of a mesh inside a GeometryBuffer
+struct GeometryRange {
+  unsigned int baseVertex;
+  unsigned int firstIndex;
+  unsigned int indexCount;
+  // vertices and indices reserved at `baseVertex` and `firstIndex`, more
+  // than used if the range was recycled from a larger mesh
+  unsigned int vertexCapacity;
+  unsigned int indexCapacity;
+};
+
+/**
+ * @brief Large shared vertex and index buffers that meshes are
+ * sub-allocated from, drawn through a single VAO.
+ *
+ * All vertices share one `VertexFormat` and all indices one index type.
+ * Both buffers grow geometrically, existing ranges stay valid. Released
+ * ranges are kept in a free list and reused by meshes that fit into them,
+ * so replacing meshes does not grow the buffers.
+ */
+class GeometryBuffer {
+ public:
+  /**
+   * @brief Construct a new Geometry Buffer object
+   *
+   * @param format layout of every vertex added
+   * @param indexType `GL_UNSIGNED_SHORT` or `GL_UNSIGNED_INT`
+   */
+  GeometryBuffer(VertexFormat format, unsigned int indexType);
+
+  /**
+   * @brief Deletes the vertex array and buffers, the GL context must still
+   * be current
+   *
+   */
+  ~GeometryBuffer();
+
+  GeometryBuffer(const GeometryBuffer&) = delete;
+  GeometryBuffer& operator=(const GeometryBuffer&) = delete;
+
+  /**
+   * @brief Copies the contents of a mesh's own buffers on the GPU, into the
+   * smallest released range that fits or else appended
+   *
+   * @param vertexBuffer GL buffer holding `vertexCount` vertices in the
+   * format of this buffer
+   * @param vertexCount
+   * @param indexBuffer GL buffer holding `indexCount` indices of the index
+   * type of this buffer
+   * @param indexCount
+   * @return GeometryRange to build draw commands with
+   */
+  GeometryRange add(unsigned int vertexBuffer,
+                    unsigned int vertexCount,
+                    unsigned int indexBuffer,
+                    unsigned int indexCount);
+
+  /**
+   * @brief Returns a range to the free list, draws already submitted with
+   * it still read the old contents
+   *
+   * @param range returned by `add()`, not used afterwards
+   */
+  void release(const GeometryRange& range);
+
+  /**
+   * @brief Binds the shared VAO
+   *
+   */
+  void bind() const;
+
+  VertexFormat getFormat() const { return format_; }
+
+  unsigned int getIndexType() const { return indexType_; }
+
+ private:
+  unsigned int VAO, VBO, EBO;
+
+  VertexFormat format_;
+  size_t vertexSize_;
+  unsigned int indexType_;
+  size_t indexSize_;
+
+  unsigned int vertexCount_;
+  unsigned int indexCount_;
+  unsigned int vertexCapacity_;
+  unsigned int indexCapacity_;
+  // ranges given back by `release()`
+  std::vector<GeometryRange> freeRanges_;
+
+  /**
+   * @brief Grows the buffers to hold at least the given counts, keeping
+   * their contents
+   *
+   * @param vertexCapacity
+   * @param indexCapacity
+   */
+  void reserve(unsigned int vertexCapacity, unsigned int indexCapacity);
+};
+
+#endif
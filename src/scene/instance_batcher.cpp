@@ -0,0 +1,347 @@
+#include "scene/instance_batcher.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#include "gl_state.hpp"
+
+// bits returned by `InstanceBatcher::changeState()`
+static constexpr unsigned int STATE_PROGRAM = 1u << 0;
+static constexpr unsigned int STATE_TEXTURES = 1u << 1;
+static constexpr unsigned int STATE_VERTEX_ARRAY = 1u << 2;
+
+// set in the geometry id of meshes with 32 bit indices, so the sorted draws
+// of a bucket are grouped by index type as well
+static constexpr unsigned int GEOMETRY_ID_WIDE_INDICES =
+    1u << (SORT_KEY_GEOMETRY_BITS - 1);
+
+static GpuInstance makeInstance(const glm::mat4& model,
+                                const glm::mat3& normalMatrix,
+                                const glm::vec3& color) {
+  GpuInstance instance;
+  instance.model = model;
+  for (int i = 0; i < 3; i++) {
+    instance.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+  }
+  instance.color = color;
+  instance.material = 0;
+  return instance;
+}
+
+InstanceBatcher::InstanceBatcher()
+    : materialBuffer_(MATERIALS_SSBO_BINDING, sizeof(GpuMaterial)) {
+  nearPlane_ = glm::vec4(0.0f);
+  farPlane_ = glm::vec4(0.0f);
+  instanceCount_ = 0;
+  drawCount_ = 0;
+  unsortedStateChanges_ = {0, 0, 0};
+  stateChanges_ = {0, 0, 0};
+  multiDraw_ = false;
+  materialArrays_ = false;
+  // material 0 has no maps, used by mono colored instances
+  GpuMaterial none = {glm::ivec4(-1), 0, {0, 0, 0}};
+  materialBuffer_.push(&none);
+}
+
+void InstanceBatcher::clear(const Frustum& frustum) {
+  items_.clear();
+  instances_.clear();
+  queue_.clear();
+  nearPlane_ = frustum.planes_[4];
+  farPlane_ = frustum.planes_[5];
+}
+
+void InstanceBatcher::add(Mesh* mesh,
+                          const glm::mat4& model,
+                          const glm::mat3& normalMatrix) {
+  push(mesh, false, makeInstance(model, normalMatrix, glm::vec3(1.0f)));
+}
+
+void InstanceBatcher::add(Mesh* mesh,
+                          const glm::mat4& model,
+                          const glm::mat3& normalMatrix,
+                          const glm::vec3& color) {
+  push(mesh, true, makeInstance(model, normalMatrix, color));
+}
+
+void InstanceBatcher::push(Mesh* mesh,
+                           bool useColor,
+                           GpuInstance instance) {
+  if (materialArrays_ && !useColor) {
+    const MaterialSlot& slot = getMaterialSlot(mesh->material_.get());
+    if (slot.pooled) {
+      instance.material = slot.index;
+    }
+  }
+
+  // depth of the bounds center between the near (0) and far (1) plane
+  glm::vec3 center =
+      glm::vec3(instance.model * glm::vec4(mesh->bounds_.center, 1.0f));
+  float toNear = glm::dot(glm::vec3(nearPlane_), center) + nearPlane_.w;
+  float toFar = glm::dot(glm::vec3(farPlane_), center) + farPlane_.w;
+  float depth = toNear + toFar > 0.0f ? toNear / (toNear + toFar) : 0.0f;
+
+  // packed positions are decoded by the model matrix, normals are not
+  // quantized relative to the bounds and keep the normal matrix
+  if (mesh->vertexFormat_ == VERTEX_FORMAT_PACKED) {
+    instance.model = instance.model * mesh->dequantize_;
+  }
+
+  // sort ids are recycled, so they stay below the key field widths as long
+  // as fewer meshes and materials are alive at once
+  unsigned int geometry = mesh->getSortId().getIndex();
+  assert(geometry < GEOMETRY_ID_WIDE_INDICES);
+  if (mesh->indexType_ == GL_UNSIGNED_INT) {
+    geometry |= GEOMETRY_ID_WIDE_INDICES;
+  }
+
+  DrawState state = getDrawState(mesh, useColor);
+  queue_.push(makeSortKey(RENDER_PASS_OPAQUE, state.variant, state.textures,
+                          geometry, depth),
+              items_.size());
+  items_.push_back({state, useColor});
+  instances_.push_back(instance);
+}
+
+InstanceBatcher::DrawState InstanceBatcher::getDrawState(Mesh* mesh,
+                                                         bool useColor) {
+  VariantKey vertexVariant =
+      mesh->vertexFormat_ == VERTEX_FORMAT_PACKED ? VARIANT_PACKED_VERTICES : 0;
+  if (materialArrays_ &&
+      (useColor || getMaterialSlot(mesh->material_.get()).pooled)) {
+    // maps come from the material buffer, nothing to bind per draw
+    return {VARIANT_MATERIAL_ARRAYS | vertexVariant, 0, mesh};
+  }
+  if (useColor) {
+    // flat colors use the color for specular highlights as well
+    return {VARIANT_SPECULAR | vertexVariant, 0, mesh};
+  }
+
+  // materials are shared between meshes with the same maps, 0 is kept for
+  // mono colored meshes
+  const Material* material = mesh->material_.get();
+  unsigned int textures = material->getSortId().getIndex() + 1;
+  assert(textures < (1u << SORT_KEY_TEXTURES_BITS));
+  return {material->getVariantKey() | vertexVariant, textures, mesh};
+}
+
+unsigned int InstanceBatcher::changeState(DrawState& bound,
+                                          const DrawState& next,
+                                          RenderStateChanges& changes) {
+  unsigned int changed = 0;
+  if (next.variant != bound.variant) {
+    changed |= STATE_PROGRAM;
+    changes.programs++;
+  }
+  // samplers read fixed texture units in every program, so textures stay
+  // bound across program changes. Mono colored draws leave them alone.
+  if (next.textures != 0 && next.textures != bound.textures) {
+    changed |= STATE_TEXTURES;
+    changes.textures++;
+    bound.textures = next.textures;
+  }
+  if (next.mesh != bound.mesh) {
+    changed |= STATE_VERTEX_ARRAY;
+    changes.vertexArrays++;
+  }
+  bound.variant = next.variant;
+  bound.mesh = next.mesh;
+  return changed;
+}
+
+void InstanceBatcher::draw(ShaderVariants& shaders, RingBuffer& ring) {
+  // what submitting every instance in the order added would have cost
+  unsortedStateChanges_ = {0, 0, 0};
+  DrawState bound = {~0u, 0, nullptr};
+  for (const Item& item : items_) {
+    changeState(bound, item.state, unsortedStateChanges_);
+  }
+
+  queue_.sort();
+
+  // pack the instances in sorted order straight into mapped memory, each
+  // run of one mesh becomes a draw
+  unsigned int count = queue_.size();
+  RingAllocation instances = ring.allocate(
+      STORAGE_BUFFER_HEADER_SIZE + count * sizeof(GpuInstance));
+  std::memcpy(instances.data, &count, sizeof(count));
+  GpuInstance* gpuInstances = (GpuInstance*)((char*)instances.data +
+                                             STORAGE_BUFFER_HEADER_SIZE);
+  draws_.clear();
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int index = queue_.getValue(i);
+    gpuInstances[i] = instances_[index];
+
+    const Item& item = items_[index];
+    if (draws_.empty() || draws_.back().state.mesh != item.state.mesh ||
+        draws_.back().useColor != item.useColor) {
+      draws_.push_back({item.state, item.useColor, i, 0});
+    }
+    draws_.back().instanceCount++;
+  }
+  ring.bindRange(GL_SHADER_STORAGE_BUFFER, INSTANCES_SSBO_BINDING, instances);
+  instanceCount_ = count;
+
+  stateChanges_ = {0, 0, 0};
+  if (materialArrays_) {
+    materialBuffer_.upload();
+    textureArrays_.bind();
+  }
+  if (multiDraw_) {
+    drawMultiIndirect(shaders, ring);
+  } else {
+    drawInstanced(shaders);
+  }
+}
+
+void InstanceBatcher::drawInstanced(ShaderVariants& shaders) {
+  DrawState bound = {~0u, 0, nullptr};
+  for (const Draw& draw : draws_) {
+    const DrawState& state = draw.state;
+    unsigned int changed = changeState(bound, state, stateChanges_);
+    // binding the already bound program is filtered by `GlState`
+    shaders.use(shaders.getBaseKey() | state.variant);
+    if (changed & STATE_TEXTURES) {
+      state.mesh->material_->bind();
+    }
+    if (changed & STATE_VERTEX_ARRAY) {
+      GlState::bindVertexArray(state.mesh->getVertexArray());
+    }
+    glDrawElementsInstancedBaseInstance(
+        GL_TRIANGLES, state.mesh->getIndexCount(), state.mesh->indexType_, 0,
+        draw.instanceCount, draw.baseInstance);
+  }
+  drawCount_ = draws_.size();
+}
+
+void InstanceBatcher::drawMultiIndirect(ShaderVariants& shaders,
+                                        RingBuffer& ring) {
+  unsigned int count = draws_.size();
+  RingAllocation commands =
+      ring.allocate(count * sizeof(DrawElementsIndirectCommand));
+  DrawElementsIndirectCommand* gpuCommands =
+      (DrawElementsIndirectCommand*)commands.data;
+
+  // the sorted draws sharing program, textures and geometry buffer are
+  // adjacent, each run is one bucket
+  buckets_.clear();
+  for (unsigned int i = 0; i < count; i++) {
+    const Draw& draw = draws_[i];
+    GeometryBuffer* geometry = &getGeometry(draw.state.mesh);
+    if (buckets_.empty() ||
+        draws_[i - 1].state.variant != draw.state.variant ||
+        draws_[i - 1].state.textures != draw.state.textures ||
+        buckets_.back().geometry != geometry) {
+      buckets_.push_back({i, 0, geometry});
+    }
+    buckets_.back().drawCount++;
+
+    const GeometryRange& range = getGeometryRange(draw.state.mesh);
+    gpuCommands[i] = {range.indexCount, draw.instanceCount, range.firstIndex,
+                      (int)range.baseVertex, draw.baseInstance};
+  }
+  GlState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+
+  // all meshes of a vertex format and index type share one vertex array
+  const GeometryBuffer* boundGeometry = nullptr;
+  DrawState bound = {~0u, 0, nullptr};
+  for (const Bucket& bucket : buckets_) {
+    if (bucket.geometry != boundGeometry) {
+      bucket.geometry->bind();
+      boundGeometry = bucket.geometry;
+      stateChanges_.vertexArrays++;
+    }
+    DrawState state = draws_[bucket.firstDraw].state;
+    state.mesh = nullptr;
+    unsigned int changed = changeState(bound, state, stateChanges_);
+    shaders.use(shaders.getBaseKey() | state.variant);
+    if (changed & STATE_TEXTURES) {
+      draws_[bucket.firstDraw].state.mesh->material_->bind();
+    }
+    glMultiDrawElementsIndirect(
+        GL_TRIANGLES, bucket.geometry->getIndexType(),
+        (void*)(commands.offset +
+                bucket.firstDraw * sizeof(DrawElementsIndirectCommand)),
+        bucket.drawCount, 0);
+  }
+  drawCount_ = buckets_.size();
+}
+
+const GeometryRange& InstanceBatcher::getGeometryRange(Mesh* mesh) {
+  const SortId& id = mesh->getSortId();
+  if (id.getIndex() >= geometryRanges_.size()) {
+    geometryRanges_.resize(id.getIndex() + 1, {0, {nullptr, {}}});
+  }
+  SortIdEntry<MeshGeometry>& entry = geometryRanges_[id.getIndex()];
+  if (entry.generation != id.getGeneration()) {
+    // first use, or the id belonged to a mesh that was destroyed, whose
+    // range the new mesh may take over
+    if (entry.generation != 0) {
+      entry.value.buffer->release(entry.value.range);
+    }
+    GeometryBuffer& buffer = getGeometry(mesh);
+    entry.generation = id.getGeneration();
+    entry.value.buffer = &buffer;
+    entry.value.range =
+        buffer.add(mesh->getVertexBuffer(), mesh->getVertexCount(),
+                   mesh->getIndexBuffer(), mesh->getIndexCount());
+  }
+  return entry.value.range;
+}
+
+GeometryBuffer& InstanceBatcher::getGeometry(const Mesh* mesh) {
+  bool wideIndices = mesh->indexType_ == GL_UNSIGNED_INT;
+  std::unique_ptr<GeometryBuffer>& geometry =
+      geometry_[mesh->vertexFormat_][wideIndices];
+  if (!geometry) {
+    geometry = std::make_unique<GeometryBuffer>(mesh->vertexFormat_,
+                                                mesh->indexType_);
+  }
+  return *geometry;
+}
+
+const InstanceBatcher::MaterialSlot& InstanceBatcher::getMaterialSlot(
+    Material* material) {
+  const SortId& id = material->getSortId();
+  if (id.getIndex() >= materialSlots_.size()) {
+    materialSlots_.resize(id.getIndex() + 1, {0, {0, false}});
+  }
+  SortIdEntry<MaterialSlot>& entry = materialSlots_[id.getIndex()];
+  if (entry.generation == id.getGeneration()) {
+    return entry.value;
+  }
+
+  GpuMaterial gpuMaterial = {glm::ivec4(-1), 0, {0, 0, 0}};
+  bool pooled = true;
+  for (const Texture& texture : material->getTextures()) {
+    // the first map of each type is used, like `Material::bind()`
+    uint32_t flag = texture.type == TEXTURE_DIFFUSE ? GPU_MATERIAL_DIFFUSE_MAP
+                                                    : GPU_MATERIAL_SPECULAR_MAP;
+    if (gpuMaterial.flags & flag) {
+      continue;
+    }
+    TextureLayer layer = textureArrays_.add(texture.id);
+    if (layer.array < 0) {
+      // dropping the map would change the image, bind it instead
+      pooled = false;
+      break;
+    }
+    gpuMaterial.flags |= flag;
+    if (texture.type == TEXTURE_DIFFUSE) {
+      gpuMaterial.maps.x = layer.array;
+      gpuMaterial.maps.y = layer.layer;
+    } else {
+      gpuMaterial.maps.z = layer.array;
+      gpuMaterial.maps.w = layer.layer;
+    }
+  }
+  // a destroyed material's slot is taken over with its sort id
+  if (entry.generation != 0) {
+    materialBuffer_.write(entry.value.index, &gpuMaterial);
+  } else {
+    entry.value.index = materialBuffer_.push(&gpuMaterial);
+  }
+  entry.value.pooled = pooled;
+  entry.generation = id.getGeneration();
+  return entry.value;
+}
@@ -0,0 +1,366 @@
+#ifndef INSTANCE_BATCHER_H
+#define INSTANCE_BATCHER_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "frustum.hpp"
+#include "ring_buffer.hpp"
+#include "scene/geometry_buffer.hpp"
+#include "scene/mesh.hpp"
+#include "scene/render_queue.hpp"
+#include "shader_variants.hpp"
+#include "storage_buffer.hpp"
+#include "texture_arrays.hpp"
+
+// shader storage buffer binding point of the instance block in
+// vLightShader.glsl
+constexpr unsigned int INSTANCES_SSBO_BINDING = 6;
+// binding point of the materials used with `VARIANT_MATERIAL_ARRAYS`
+constexpr unsigned int MATERIALS_SSBO_BINDING = 8;
+
+// std430 mirror of the Instance struct in vLightShader.glsl. The normal
+// matrix is stored as three vec4 columns, matching the std430 mat3 layout.
+struct GpuInstance {
+  glm::mat4 model;
+  glm::vec4 normalMatrix[3];
+  glm::vec3 color;  // used by meshes without textures
+  // index into the material buffer, 0 (no maps) unless material arrays are
+  // used
+  uint32_t material;
+};
+
+static_assert(sizeof(GpuInstance) == 128 && alignof(GpuInstance) == 4,
+              "GpuInstance does not match std430 layout");
+
+// flags of `GpuMaterial`
+constexpr uint32_t GPU_MATERIAL_DIFFUSE_MAP = 1u << 0;
+constexpr uint32_t GPU_MATERIAL_SPECULAR_MAP = 1u << 1;
+
+// std430 mirror of the MaterialData struct in fLightShader.glsl. `maps`
+// holds the texture array and layer of the diffuse (xy) and specular (zw)
+// map, see `TextureArrays`.
+struct GpuMaterial {
+  glm::ivec4 maps;
+  uint32_t flags;
+  uint32_t pad[3];
+};
+
+static_assert(sizeof(GpuMaterial) == 32, "GpuMaterial does not match std430");
+
+// layout of one command consumed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+  unsigned int count;
+  unsigned int instanceCount;
+  unsigned int firstIndex;
+  int baseVertex;
+  unsigned int baseInstance;
+};
+
+// number of GL state changes needed to submit a frame's draws
+struct RenderStateChanges {
+  unsigned int programs;
+  unsigned int textures;
+  unsigned int vertexArrays;
+};
+
+/**
+ * @brief Groups the instances of a frame by Mesh and draws each group with
+ * a single instanced draw call.
+ *
+ * Every instance goes through a `RenderQueue` keyed by shader variant,
+ * texture set, mesh and depth. After sorting, instances of the same mesh
+ * are adjacent (front to back) and form one draw, and draws sharing a
+ * program or textures follow each other, so only the state that changes
+ * is bound.
+ *
+ * The per-instance data of all groups is written to the frame's
+ * `RingBuffer` region in one block, each group reads its range through
+ * `gl_BaseInstance + gl_InstanceID`.
+ *
+ * In multi-draw mode all meshes are copied into a shared `GeometryBuffer`
+ * per vertex format and index type, and the groups are bucketed by shader
+ * variant, textures and geometry buffer. Each bucket is drawn with one
+ * `glMultiDrawElementsIndirect` over commands in the ring. Every command
+ * carries its group's first instance as base instance, so the same programs
+ * serve both paths and no uniform is set per bucket.
+ *
+ * With material arrays the maps of every material are copied into
+ * `TextureArrays` and described in a material storage buffer that each
+ * instance indexes. All textured meshes then share one program and one set
+ * of texture bindings, so multi-draw merges meshes of different materials
+ * into a single call. A material with a map that fits none of the
+ * `MAX_TEXTURE_ARRAYS` pools keeps binding its own textures.
+ *
+ * Meshes with packed vertices get `PACKED_VERTICES` in their variant and
+ * their dequantization folded into the instance model matrix.
+ */
+class InstanceBatcher {
+ public:
+  /**
+   * @brief Construct a new Instance Batcher object
+   *
+   */
+  InstanceBatcher();
+
+  /**
+   * @brief Removes all instances, keeping the allocations
+   *
+   * @param frustum camera frustum of the next `draw()`, its near and far
+   * planes define the depth used for sorting
+   */
+  void clear(const Frustum& frustum);
+
+  /**
+   * @brief Adds an instance of a textured mesh
+   *
+   * @param mesh
+   * @param model Model matrix
+   * @param normalMatrix inverse transpose of the upper 3x3 of `model`
+   */
+  void add(Mesh* mesh, const glm::mat4& model, const glm::mat3& normalMatrix);
+
+  /**
+   * @brief Adds an instance of a mono colored mesh
+   *
+   * @param mesh
+   * @param model Model matrix
+   * @param normalMatrix inverse transpose of the upper 3x3 of `model`
+   * @param color
+   */
+  void add(Mesh* mesh,
+           const glm::mat4& model,
+           const glm::mat3& normalMatrix,
+           const glm::vec3& color);
+
+  /**
+   * @brief Sorts the instances added since `clear()`, writes them to `ring`
+   * and draws every group with one instanced draw call
+   *
+   * @param shaders
+   * @param ring per-frame data of the current frame
+   */
+  void draw(ShaderVariants& shaders, RingBuffer& ring);
+
+  /**
+   * @brief Switches between one instanced draw call per mesh and one
+   * multi-draw-indirect call per shader/texture bucket
+   *
+   * @param multiDraw
+   */
+  void setMultiDraw(bool multiDraw) { multiDraw_ = multiDraw; }
+
+  /**
+   * @brief Check if multi-draw-indirect is used, see `setMultiDraw()`
+   *
+   * @return bool
+   */
+  bool getMultiDraw() const { return multiDraw_; }
+
+  /**
+   * @brief Switches between binding each material's textures and sampling
+   * all materials from texture arrays through the material buffer
+   *
+   * @param materialArrays
+   */
+  void setMaterialArrays(bool materialArrays) {
+    materialArrays_ = materialArrays;
+  }
+
+  /**
+   * @brief Check if material arrays are used, see `setMaterialArrays()`
+   *
+   * @return bool
+   */
+  bool getMaterialArrays() const { return materialArrays_; }
+
+  /**
+   * @brief Get the number of draw calls issued by the last `draw()`
+   *
+   * @return unsigned int
+   */
+  unsigned int getDrawCount() const { return drawCount_; }
+
+  /**
+   * @brief Get the number of instances drawn by the last `draw()`
+   *
+   * @return unsigned int
+   */
+  unsigned int getInstanceCount() const { return instanceCount_; }
+
+  /**
+   * @brief Get the state changes the last `draw()` would have needed
+   * without sorting, drawing every instance on its own in the order added
+   *
+   * @return const RenderStateChanges&
+   */
+  const RenderStateChanges& getUnsortedStateChanges() const {
+    return unsortedStateChanges_;
+  }
+
+  /**
+   * @brief Get the state changes issued by the last `draw()`
+   *
+   * @return const RenderStateChanges&
+   */
+  const RenderStateChanges& getStateChanges() const { return stateChanges_; }
+
+ private:
+  // state a draw needs bound, compared to skip redundant binds
+  struct DrawState {
+    VariantKey variant;
+    // texture set id, 0 for mono colored meshes which bind no textures
+    unsigned int textures;
+    Mesh* mesh;
+  };
+
+  struct Item {
+    DrawState state;
+    bool useColor;
+  };
+
+  // entry of a table indexed by the `SortId` of a mesh or material, stale
+  // if `generation` is not the generation of the current owner
+  template <typename T>
+  struct SortIdEntry {
+    uint32_t generation;
+    T value;
+  };
+
+  // range of a mesh and the geometry buffer it was copied to
+  struct MeshGeometry {
+    GeometryBuffer* buffer;
+    GeometryRange range;
+  };
+
+  // record of a material in `materialBuffer_`
+  struct MaterialSlot {
+    unsigned int index;
+    // false if a map did not fit into `textureArrays_`, the material is then
+    // drawn with its own textures bound
+    bool pooled;
+  };
+
+  // instances of one mesh, adjacent in the sorted queue
+  struct Draw {
+    DrawState state;
+    bool useColor;
+    unsigned int baseInstance;
+    unsigned int instanceCount;
+  };
+
+  // draws sharing program, textures and geometry buffer, drawn by one
+  // multi-draw call
+  struct Bucket {
+    unsigned int firstDraw;
+    unsigned int drawCount;
+    GeometryBuffer* geometry;
+  };
+
+  // per instance added since `clear()`, indexed by the queue values
+  std::vector<Item> items_;
+  std::vector<GpuInstance> instances_;
+  RenderQueue queue_;
+  std::vector<Draw> draws_;
+
+  // near and far plane of the current frustum, for sort depths
+  glm::vec4 nearPlane_;
+  glm::vec4 farPlane_;
+
+  unsigned int instanceCount_;
+  unsigned int drawCount_;
+  RenderStateChanges unsortedStateChanges_;
+  RenderStateChanges stateChanges_;
+
+  bool multiDraw_;
+  // indexed by vertex format and 32 bit indices, created on first use
+  std::unique_ptr<GeometryBuffer> geometry_[2][2];
+  // location of each mesh in its geometry buffer by mesh sort id, copied
+  // on first multi-draw use. The range of a destroyed mesh is released when
+  // its sort id is reused.
+  std::vector<SortIdEntry<MeshGeometry>> geometryRanges_;
+  std::vector<Bucket> buckets_;
+
+  bool materialArrays_;
+  TextureArrays textureArrays_;
+  // slot in `materialBuffer_` by material sort id, added on first use.
+  // A material reusing the sort id of a destroyed one overwrites its slot.
+  std::vector<SortIdEntry<MaterialSlot>> materialSlots_;
+  StorageBuffer materialBuffer_;
+
+  /**
+   * @brief Queues one instance
+   *
+   * @param mesh
+   * @param useColor
+   * @param instance
+   */
+  void push(Mesh* mesh, bool useColor, GpuInstance instance);
+
+  /**
+   * @brief Get the draw state of an instance
+   *
+   * @param mesh
+   * @param useColor
+   * @return DrawState
+   */
+  DrawState getDrawState(Mesh* mesh, bool useColor);
+
+  /**
+   * @brief Moves `bound` to `next` and counts the state that had to change
+   *
+   * @param bound state bound so far, `variant` ~0u if nothing is bound
+   * @param next
+   * @param changes incremented per changed state
+   * @return unsigned int mask of the `STATE_*` bits that changed
+   */
+  static unsigned int changeState(DrawState& bound,
+                                  const DrawState& next,
+                                  RenderStateChanges& changes);
+
+  /**
+   * @brief Draws `draws_` with one instanced draw call each
+   *
+   * @param shaders
+   */
+  void drawInstanced(ShaderVariants& shaders);
+
+  /**
+   * @brief Draws `draws_` with one multi-draw-indirect call per bucket
+   *
+   * @param shaders
+   * @param ring receives the indirect commands
+   */
+  void drawMultiIndirect(ShaderVariants& shaders, RingBuffer& ring);
+
+  /**
+   * @brief Get the shared geometry buffer matching the vertex format and
+   * index type of `mesh`, creating it on first use
+   *
+   * @param mesh
+   * @return GeometryBuffer&
+   */
+  GeometryBuffer& getGeometry(const Mesh* mesh);
+
+  /**
+   * @brief Get the range of `mesh` in its geometry buffer, copying it there
+   * on first use
+   *
+   * @param mesh
+   * @return const GeometryRange&
+   */
+  const GeometryRange& getGeometryRange(Mesh* mesh);
+
+  /**
+   * @brief Get the slot of `material` in `materialBuffer_`, copying its
+   * maps into `textureArrays_` on first use
+   *
+   * @param material
+   * @return const MaterialSlot&
+   */
+  const MaterialSlot& getMaterialSlot(Material* material);
+};
+
+#endif
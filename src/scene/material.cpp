@@ -0,0 +1,37 @@
+#include "scene/material.hpp"
+
+#include "gl_state.hpp"
+
+Material::Material() : Material(std::vector<Texture>()) {}
+
+Material::Material(std::vector<Texture> textures)
+    : textures_(std::move(textures)), sortId_(getSortIdPool()) {
+  for (unsigned int& unit : units_) {
+    unit = 0;
+  }
+  variantKey_ = 0;
+  for (const Texture& texture : textures_) {
+    if (units_[texture.type] != 0) {
+      continue;
+    }
+    units_[texture.type] = texture.id;
+    if (texture.type == TEXTURE_DIFFUSE) {
+      variantKey_ |= VARIANT_TEXTURED;
+    } else if (texture.type == TEXTURE_SPECULAR) {
+      variantKey_ |= VARIANT_SPECULAR;
+    }
+  }
+}
+
+SortIdPool& Material::getSortIdPool() {
+  static SortIdPool pool;
+  return pool;
+}
+
+void Material::bind() const {
+  for (unsigned int unit = 0; unit < TEXTURE_TYPE_COUNT; unit++) {
+    if (units_[unit] != 0) {
+      GlState::bindTexture(unit, units_[unit]);
+    }
+  }
+}
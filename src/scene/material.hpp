@@ -0,0 +1,74 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <string>
+#include <vector>
+
+#include "scene/sort_id.hpp"
+#include "shader.hpp"
+#include "shader_variants.hpp"
+
+struct Texture {
+  unsigned int id;
+  TextureType type;
+  std::string path;  // empty if texture is generated
+};
+
+/**
+ * @brief Texture maps of a surface, shared by all meshes using them.
+ *
+ * The texture of each `TextureType` is bound to the unit of the same index,
+ * which every program's sampler points at since linking (see
+ * `UniformHandles::materialSamplers`). Binding a material is therefore one
+ * texture bind per map, without touching uniforms.
+ */
+class Material {
+ public:
+  /**
+   * @brief Construct a material without textures
+   *
+   */
+  Material();
+
+  /**
+   * @brief Construct a new Material object. Only the first texture of each
+   * type is sampled by the shaders.
+   *
+   * @param textures
+   */
+  explicit Material(std::vector<Texture> textures);
+
+  /**
+   * @brief Binds every map to the texture unit of its type
+   *
+   */
+  void bind() const;
+
+  /**
+   * @brief Get the material bits of the shader `VariantKey`
+   *
+   * @return VariantKey
+   */
+  VariantKey getVariantKey() const { return variantKey_; }
+
+  const std::vector<Texture>& getTextures() const { return textures_; }
+
+  /**
+   * @brief Get the id of the material in draw sort keys, reused by another
+   * material once this one is destroyed
+   *
+   * @return const SortId&
+   */
+  const SortId& getSortId() const { return sortId_; }
+
+ private:
+  std::vector<Texture> textures_;
+  // texture bound to each unit, 0 if the material has no such map
+  unsigned int units_[TEXTURE_TYPE_COUNT];
+  VariantKey variantKey_;
+  SortId sortId_;
+
+  static SortIdPool& getSortIdPool();
+};
+
+#endif
@@ -2,77 +2,73 @@
 
 Mesh::Mesh(std::vector<Vertex> vertices,
            std::vector<unsigned int> indices,
-           std::vector<Texture> textures)
-    : vertices_(vertices), indices_(indices), textures_(textures) {
-  setupMesh();
+           std::shared_ptr<Material> material,
+           VertexFormat format,
+           MeshRetention retention)
+    : vertices_(std::move(vertices)),
+      indices_(std::move(indices)),
+      material_(std::move(material)),
+      sortId_(getSortIdPool()) {
+  vertexCount_ = vertices_.size();
+  indexCount_ = indices_.size();
+  setupMesh(format);
+  releaseCpuData(retention);
 }
 
-void Mesh::draw(Shader& shader) {
-  // naming convention: each diffuse texture is named texture_diffuseN, and each
-  // specular texture should be named texture_specularN
+SortIdPool& Mesh::getSortIdPool() {
+  static SortIdPool pool;
+  return pool;
+}
 
-  shader.setBool("material.useColor", false);
+void Mesh::setupMesh(VertexFormat format) {
+  bounds_ =
+      makeBounds(&vertices_[0].position, vertices_.size(), sizeof(Vertex));
 
-  unsigned int diffuseNr = 1;
-  unsigned int specularNr = 1;
-  for (unsigned int i = 0; i < textures_.size(); i++) {
-    // activate proper texture unit before binding
-    glActiveTexture(GL_TEXTURE0 + i);
-    // retrieve texture number (the N in diffuse_textureN)
-    std::string number;
-    std::string name = textures_[i].type;
-    if (name == "texture_diffuse") {
-      number = std::to_string(diffuseNr++);
-    } else if (name == "texture_specular") {
-      number = std::to_string(specularNr++);
-    }
-    shader.setInt(("material." + name + number).c_str(), i);
-    glBindTexture(GL_TEXTURE_2D, textures_[i].id);
+  vertexFormat_ = VERTEX_FORMAT_FLOAT;
+  dequantize_ = glm::mat4(1.0f);
+  std::vector<PackedVertex> packed;
+  if (format == VERTEX_FORMAT_PACKED &&
+      packVertices(vertices_.data(), vertices_.size(), bounds_, packed,
+                   dequantize_)) {
+    vertexFormat_ = VERTEX_FORMAT_PACKED;
   }
-  glActiveTexture(GL_TEXTURE0);
+  const void* vertexData = vertexFormat_ == VERTEX_FORMAT_PACKED
+                               ? (const void*)packed.data()
+                               : (const void*)vertices_.data();
+  size_t vertexSize = getVertexSize(vertexFormat_);
 
-  // draw mesh
-  glBindVertexArray(VAO);
-  glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
-}
+  indexType_ = getIndexType(vertices_.size());
+  std::vector<uint16_t> shortIndices;
+  const void* indexData = indices_.data();
+  if (indexType_ == GL_UNSIGNED_SHORT) {
+    shortIndices.assign(indices_.begin(), indices_.end());
+    indexData = shortIndices.data();
+  }
 
-void Mesh::draw(Shader& shader, glm::vec3 color) {
-  shader.setBool("material.useColor", true);
-  shader.setVec3("material.color", color);
+  // immutable storage, written once here and only copied from afterwards
+  glCreateBuffers(1, &VBO);
+  glNamedBufferStorage(VBO, vertexCount_ * vertexSize, vertexData, 0);
+  glCreateBuffers(1, &EBO);
+  glNamedBufferStorage(EBO, getIndexBufferSize(), indexData, 0);
 
-  // draw mesh
-  glBindVertexArray(VAO);
-  glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
+  // vertex positions, normals and texture coords
+  glCreateVertexArrays(1, &VAO);
+  setupVertexAttributes(VAO, vertexFormat_);
+  glVertexArrayVertexBuffer(VAO, 0, VBO, 0, vertexSize);
+  glVertexArrayElementBuffer(VAO, EBO);
 }
 
-void Mesh::setupMesh() {
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
-  glGenBuffers(1, &EBO);
-
-  glBindVertexArray(VAO);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-  glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(Vertex),
-               &vertices_[0], GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(unsigned int),
-               &indices_[0], GL_STATIC_DRAW);
-
-  // vertex positions
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-  // vertex normals
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void*)offsetof(Vertex, normal));
-  // vertex texture coords
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void*)offsetof(Vertex, texCoords));
-
-  // unbind VAO
-  glBindVertexArray(0);
+void Mesh::releaseCpuData(MeshRetention retention) {
+  if (retention == MESH_RETAIN_ALL) {
+    return;
+  }
+  if (retention == MESH_RETAIN_COLLISION) {
+    positions_.reserve(vertices_.size());
+    for (const Vertex& vertex : vertices_) {
+      positions_.push_back(vertex.position);
+    }
+  } else {
+    std::vector<unsigned int>().swap(indices_);
+  }
+  std::vector<Vertex>().swap(vertices_);
 }
\ No newline at end of file
@@ -4,65 +4,109 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "bounds.hpp"
+#include "scene/material.hpp"
+#include "scene/sort_id.hpp"
+#include "scene/vertex_format.hpp"
 #include "shader.hpp"
+#include "shader_variants.hpp"
 #include "utils.hpp"
 
-struct Vertex {
-  glm::vec3 position;
-  glm::vec3 normal;
-  glm::vec2 texCoords;
-};
-
-struct Texture {
-  unsigned int id;
-  std::string type;
-  std::string path;  // empty if texture is generated
+// what a Mesh keeps in RAM after uploading its buffers
+enum MeshRetention {
+  // only the derived data: counts, bounds and formats
+  MESH_RETAIN_NONE,
+  // additionally positions and indices, for CPU collision and picking
+  MESH_RETAIN_COLLISION,
+  // the full `vertices_` and `indices_`
+  MESH_RETAIN_ALL
 };
 
 class Mesh {
  public:
-  // mesh data
+  // mesh data, empty after upload unless retained (see `MeshRetention`)
   std::vector<Vertex> vertices_;
   std::vector<unsigned int> indices_;
-  std::vector<Texture> textures_;
+  // object space positions, kept with `MESH_RETAIN_COLLISION`
+  std::vector<glm::vec3> positions_;
+  // shared with the other meshes using the same texture maps
+  std::shared_ptr<Material> material_;
+  // object space bounds of the vertices
+  Bounds bounds_;
+  // layout of the uploaded vertex buffer, `vertices_` is always float
+  VertexFormat vertexFormat_;
+  // maps packed positions to object space, identity for float vertices
+  glm::mat4 dequantize_;
+  // type of the uploaded index buffer, `indices_` is always 32 bit
+  unsigned int indexType_;
 
   /**
    * @brief Construct a new Mesh object
    *
    * @param vertices
    * @param indices
-   * @param textures
+   * @param material
+   * @param format requested vertex buffer layout, packing falls back to
+   * float when it would exceed the error bounds of scene/vertex_format.hpp
+   * @param retention data kept in RAM after the upload
    */
   Mesh(std::vector<Vertex> vertices,
        std::vector<unsigned int> indices,
-       std::vector<Texture> textures);
+       std::shared_ptr<Material> material,
+       VertexFormat format = VERTEX_FORMAT_FLOAT,
+       MeshRetention retention = MESH_RETAIN_NONE);
+
+  unsigned int getVertexArray() const { return VAO; }
+  unsigned int getVertexBuffer() const { return VBO; }
+  unsigned int getIndexBuffer() const { return EBO; }
 
   /**
-   * @brief Draws mesh to screen
+   * @brief Get the id of the mesh in draw sort keys, reused by another mesh
+   * once this one is destroyed
    *
-   * @param shader
+   * @return const SortId&
    */
-  void draw(Shader& shader);
+  const SortId& getSortId() const { return sortId_; }
+
+  unsigned int getVertexCount() const { return vertexCount_; }
+  unsigned int getIndexCount() const { return indexCount_; }
 
   /**
-   * @brief Draws mesh to screen (mono colored Mesh)
+   * @brief Get the size of the uploaded index buffer in bytes
    *
-   * @param shader
+   * @return size_t
    */
-  void draw(Shader& shader, glm::vec3 color);
+  size_t getIndexBufferSize() const {
+    return indexCount_ * getIndexSize(indexType_);
+  }
 
  private:
   // render data
   unsigned int VAO, VBO, EBO;
+  unsigned int vertexCount_;
+  unsigned int indexCount_;
+  SortId sortId_;
+
+  static SortIdPool& getSortIdPool();
 
   /**
    * @brief Creates and maps VAO, VBO and EBO in OpenGL
    *
+   * @param format requested vertex buffer layout
+   */
+  void setupMesh(VertexFormat format);
+
+  /**
+   * @brief Frees the CPU copies of the uploaded data not covered by
+   * `retention`
+   *
+   * @param retention
    */
-  void setupMesh();
+  void releaseCpuData(MeshRetention retention);
 };
 
 #endif
@@ -49,8 +49,7 @@ std::unique_ptr<Mesh> makeBox() {
   // clang-format on
 
   // no textures (fallback color in shader will be used)
-  std::vector<Texture> textures;
-
-  return std::make_unique<Mesh>(vertices, indices, textures);
+  return std::make_unique<Mesh>(std::move(vertices), std::move(indices),
+                                std::make_shared<Material>());
 }
 }  // namespace MeshFactory
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include "scene/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// LRU cache size Forsyth's scoring models
+static const int FORSYTH_CACHE_SIZE = 32;
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+static const unsigned int NO_TRIANGLE = ~0u;
+static const unsigned int NO_VERTEX = ~0u;
+
+/**
+ * @brief Forsyth's vertex score, high for vertices that are recently used
+ * or have few triangles left
+ *
+ * @param cachePosition position in the LRU cache, -1 if not cached
+ * @param remaining triangles using the vertex that are not emitted yet
+ * @return float
+ */
+static float vertexScore(int cachePosition, unsigned int remaining) {
+  if (remaining == 0) {
+    // no triangle left to pull in
+    return -1.0f;
+  }
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // used by the last triangle, scored lower so strips don't form fans
+      score = FORSYTH_LAST_TRIANGLE_SCORE;
+    } else {
+      float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scale,
+                       FORSYTH_CACHE_DECAY_POWER);
+    }
+  }
+  // finish off vertices with few triangles left to avoid leaving lone ones
+  score += FORSYTH_VALENCE_BOOST_SCALE *
+           std::pow((float)remaining, -FORSYTH_VALENCE_BOOST_POWER);
+  return score;
+}
+
+/**
+ * @brief Runs one triangle through a FIFO cache
+ *
+ * A vertex is cached when fewer than `cacheSize` misses happened since its
+ * own miss. Advancing `time` by more than `cacheSize` flushes the cache.
+ *
+ * @param triangle three indices
+ * @param timestamps per vertex `time` of its last miss
+ * @param time miss counter
+ * @param cacheSize
+ * @return unsigned int number of misses
+ */
+static unsigned int simulateTriangle(const unsigned int* triangle,
+                                     std::vector<unsigned int>& timestamps,
+                                     unsigned int& time,
+                                     unsigned int cacheSize) {
+  unsigned int misses = 0;
+  for (int k = 0; k < 3; k++) {
+    unsigned int vertex = triangle[k];
+    if (time - timestamps[vertex] >= cacheSize) {
+      timestamps[vertex] = time++;
+      misses++;
+    }
+  }
+  return misses;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices,
+                                        size_t vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // triangles using each vertex, the emitted ones are swapped past
+  // `remaining`
+  std::vector<unsigned int> remaining(vertexCount, 0);
+  for (unsigned int index : indices) {
+    remaining[index]++;
+  }
+  std::vector<unsigned int> offsets(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; v++) {
+    offsets[v + 1] = offsets[v] + remaining[v];
+  }
+  std::vector<unsigned int> adjacency(indices.size());
+  std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); i++) {
+    adjacency[fill[indices[i]]++] = i / 3;
+  }
+
+  std::vector<float> scores(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    scores[v] = vertexScore(-1, remaining[v]);
+  }
+  std::vector<float> triangleScores(triangleCount);
+  for (size_t t = 0; t < triangleCount; t++) {
+    triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] +
+                        scores[indices[t * 3 + 2]];
+  }
+  std::vector<bool> emitted(triangleCount, false);
+
+  std::vector<unsigned int> cache;
+  std::vector<unsigned int> nextCache;
+  cache.reserve(FORSYTH_CACHE_SIZE + 3);
+  nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+  std::vector<unsigned int> result;
+  result.reserve(indices.size());
+
+  unsigned int best = std::max_element(triangleScores.begin(),
+                                       triangleScores.end()) -
+                      triangleScores.begin();
+  // triangles before this one are all emitted
+  unsigned int cursor = 0;
+  while (best != NO_TRIANGLE) {
+    emitted[best] = true;
+    const unsigned int* triangle = &indices[best * 3];
+    result.insert(result.end(), triangle, triangle + 3);
+
+    // the triangle's vertices move to the front of the cache
+    nextCache.clear();
+    for (int k = 0; k < 3; k++) {
+      unsigned int vertex = triangle[k];
+      unsigned int* begin = &adjacency[offsets[vertex]];
+      unsigned int* end = begin + remaining[vertex];
+      std::iter_swap(std::find(begin, end, best), end - 1);
+      remaining[vertex]--;
+      if (std::find(nextCache.begin(), nextCache.end(), vertex) ==
+          nextCache.end()) {
+        nextCache.push_back(vertex);
+      }
+    }
+    for (unsigned int vertex : cache) {
+      if (std::find(nextCache.begin(), nextCache.end(), vertex) ==
+          nextCache.end()) {
+        nextCache.push_back(vertex);
+      }
+    }
+
+    // rescore the cached vertices and the ones just evicted
+    for (size_t i = 0; i < nextCache.size(); i++) {
+      unsigned int vertex = nextCache[i];
+      int position = i < (size_t)FORSYTH_CACHE_SIZE ? (int)i : -1;
+      float score = vertexScore(position, remaining[vertex]);
+      float delta = score - scores[vertex];
+      scores[vertex] = score;
+      for (unsigned int j = 0; j < remaining[vertex]; j++) {
+        triangleScores[adjacency[offsets[vertex] + j]] += delta;
+      }
+    }
+    if (nextCache.size() > (size_t)FORSYTH_CACHE_SIZE) {
+      nextCache.resize(FORSYTH_CACHE_SIZE);
+    }
+    cache.swap(nextCache);
+
+    // continue with the best triangle touching the cache
+    best = NO_TRIANGLE;
+    float bestScore = -1.0f;
+    for (unsigned int vertex : cache) {
+      for (unsigned int j = 0; j < remaining[vertex]; j++) {
+        unsigned int t = adjacency[offsets[vertex] + j];
+        if (triangleScores[t] > bestScore) {
+          bestScore = triangleScores[t];
+          best = t;
+        }
+      }
+    }
+    if (best == NO_TRIANGLE) {
+      // the cache ran dry, restart at any triangle left
+      while (cursor < triangleCount && emitted[cursor]) {
+        cursor++;
+      }
+      if (cursor < triangleCount) {
+        best = cursor;
+      }
+    }
+  }
+
+  indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int>& indices,
+                                     const std::vector<Vertex>& vertices,
+                                     float threshold) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+  const unsigned int cacheSize = VERTEX_CACHE_ANALYZE_SIZE;
+  float targetAcmr =
+      analyzeVertexCache(indices, vertices.size(), cacheSize).acmr *
+      threshold;
+
+  // cut clusters where the cache starts cold anyway (hard boundary) or
+  // where the cluster so far is as cache efficient as the whole mesh (soft
+  // boundary). The cache is flushed at soft boundaries, since the clusters
+  // get reordered.
+  std::vector<unsigned int> clusters;
+  std::vector<unsigned int> timestamps(vertices.size(), 0);
+  unsigned int time = cacheSize + 1;
+  unsigned int clusterStart = 0;
+  unsigned int clusterMisses = 0;
+  clusters.push_back(0);
+  for (unsigned int t = 0; t < triangleCount; t++) {
+    if (t > clusterStart &&
+        (float)clusterMisses / (t - clusterStart) <= targetAcmr) {
+      clusters.push_back(t);
+      clusterStart = t;
+      clusterMisses = 0;
+      time += cacheSize + 1;
+    }
+    unsigned int misses =
+        simulateTriangle(&indices[t * 3], timestamps, time, cacheSize);
+    if (misses == 3 && t > clusterStart) {
+      clusters.push_back(t);
+      clusterStart = t;
+      clusterMisses = 0;
+    }
+    clusterMisses += misses;
+  }
+  clusters.push_back(triangleCount);
+
+  // area weighted centroid and normal of each cluster and the mesh
+  size_t clusterCount = clusters.size() - 1;
+  std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+  std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+  std::vector<float> areas(clusterCount, 0.0f);
+  glm::vec3 meshCentroid = glm::vec3(0.0f);
+  float meshArea = 0.0f;
+  for (size_t c = 0; c < clusterCount; c++) {
+    for (unsigned int t = clusters[c]; t < clusters[c + 1]; t++) {
+      const glm::vec3& p0 = vertices[indices[t * 3]].position;
+      const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+      const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+      glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+      float area = glm::length(normal);
+      centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+      normals[c] += normal;
+      areas[c] += area;
+    }
+    meshCentroid += centroids[c];
+    meshArea += areas[c];
+  }
+  if (meshArea > 0.0f) {
+    meshCentroid /= meshArea;
+  }
+
+  // clusters facing away from the center are drawn first, they tend to
+  // occlude the ones facing inwards
+  std::vector<float> sortKeys(clusterCount, 0.0f);
+  for (size_t c = 0; c < clusterCount; c++) {
+    float normalLength = glm::length(normals[c]);
+    if (areas[c] > 0.0f && normalLength > 0.0f) {
+      glm::vec3 centroid = centroids[c] / areas[c];
+      sortKeys[c] =
+          glm::dot(centroid - meshCentroid, normals[c] / normalLength);
+    }
+  }
+  std::vector<unsigned int> order(clusterCount);
+  for (size_t c = 0; c < clusterCount; c++) {
+    order[c] = c;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&sortKeys](unsigned int a, unsigned int b) {
+                     return sortKeys[a] > sortKeys[b];
+                   });
+
+  std::vector<unsigned int> result;
+  result.reserve(indices.size());
+  for (unsigned int c : order) {
+    result.insert(result.end(), indices.begin() + clusters[c] * 3,
+                  indices.begin() + clusters[c + 1] * 3);
+  }
+  indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices,
+                                        std::vector<unsigned int>& indices) {
+  std::vector<unsigned int> remap(vertices.size(), NO_VERTEX);
+  std::vector<Vertex> result;
+  result.reserve(vertices.size());
+  for (unsigned int& index : indices) {
+    if (remap[index] == NO_VERTEX) {
+      remap[index] = result.size();
+      result.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices.swap(result);
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(
+    const std::vector<unsigned int>& indices,
+    size_t vertexCount,
+    unsigned int cacheSize) {
+  VertexCacheStats stats = {0.0f, 0.0f};
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0 || vertexCount == 0) {
+    return stats;
+  }
+
+  std::vector<unsigned int> timestamps(vertexCount, 0);
+  unsigned int time = cacheSize + 1;
+  unsigned int misses = 0;
+  for (size_t t = 0; t < triangleCount; t++) {
+    misses += simulateTriangle(&indices[t * 3], timestamps, time, cacheSize);
+  }
+  stats.acmr = (float)misses / triangleCount;
+  stats.atvr = (float)misses / vertexCount;
+  return stats;
+}
@@ -0,0 +1,83 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "scene/vertex_format.hpp"
+
+// FIFO cache size `analyzeVertexCache()` simulates, typical for GPUs that
+// still have a fixed post-transform cache
+constexpr unsigned int VERTEX_CACHE_ANALYZE_SIZE = 16;
+// overdraw clusters may have this much worse ACMR than the cache optimized
+// order they are cut from
+constexpr float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+struct VertexCacheStats {
+  // average cache miss ratio, transformed vertices per triangle (0.5 - 3)
+  float acmr;
+  // average transformed to vertex ratio, 1 is optimal
+  float atvr;
+};
+
+/**
+ * @brief Import time reordering of triangle lists for cheaper rendering.
+ *
+ * Run in order: `optimizeVertexCache()`, `optimizeOverdraw()` and
+ * `optimizeVertexFetch()`. Each keeps the triangle list rendering the same
+ * surface.
+ */
+namespace MeshOptimizer {
+
+/**
+ * @brief Reorders triangles for post-transform vertex cache locality, using
+ * Forsyth's linear-speed vertex cache optimization
+ *
+ * @param indices triangle list, reordered in place
+ * @param vertexCount
+ */
+void optimizeVertexCache(std::vector<unsigned int>& indices,
+                         size_t vertexCount);
+
+/**
+ * @brief Reorders clusters of the cache optimized triangles so outward
+ * facing clusters come first and occlude the rest (Sander et al. 2007)
+ *
+ * Clusters are cut where the cache state restarts or the running ACMR
+ * stays within `threshold` of the whole mesh, so the cache locality is
+ * mostly kept.
+ *
+ * @param indices triangle list from `optimizeVertexCache()`, reordered in
+ * place
+ * @param vertices
+ * @param threshold allowed ACMR increase, e.g. `OVERDRAW_ACMR_THRESHOLD`
+ */
+void optimizeOverdraw(std::vector<unsigned int>& indices,
+                      const std::vector<Vertex>& vertices,
+                      float threshold);
+
+/**
+ * @brief Reorders vertices by first use in `indices` so vertex fetches
+ * walk the buffer linearly, dropping unreferenced vertices
+ *
+ * @param vertices reordered in place
+ * @param indices remapped in place
+ */
+void optimizeVertexFetch(std::vector<Vertex>& vertices,
+                         std::vector<unsigned int>& indices);
+
+/**
+ * @brief Simulates a FIFO post-transform cache over a triangle list
+ *
+ * @param indices
+ * @param vertexCount
+ * @param cacheSize
+ * @return VertexCacheStats
+ */
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices,
+                                    size_t vertexCount,
+                                    unsigned int cacheSize);
+
+}  // namespace MeshOptimizer
+
+#endif
@@ -1,12 +1,20 @@
 #include "scene/model.hpp"
 
-Model::Model(const char* path) {
+#include <iomanip>
+#include <utility>
+
+#include "scene/mesh_optimizer.hpp"
+
+Model::Model(const char* path, MeshRetention retention) {
+  retention_ = retention;
   loadModel(path);
 }
 
-void Model::draw(Shader& shader) {
+void Model::submit(InstanceBatcher& batcher,
+                   const glm::mat4& model,
+                   const glm::mat3& normalMatrix) {
   for (unsigned int i = 0; i < meshes.size(); i++) {
-    meshes[i].draw(shader);
+    batcher.add(&meshes[i], model, normalMatrix);
   }
 }
 
@@ -15,7 +23,8 @@ void Model::loadModel(std::string path) {
   // this is a bit operation, storing the flags in there. Really cool idea, will
   // def use this!
   const aiScene* scene =
-      import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+      import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs |
+                                aiProcess_JoinIdenticalVertices);
 
   if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
       !scene->mRootNode) {
@@ -24,6 +33,10 @@ void Model::loadModel(std::string path) {
   directory = path.substr(0, path.find_last_of('/'));
 
   processNode(scene->mRootNode, scene);
+
+  for (const Mesh& mesh : meshes) {
+    bounds_ = mergeBounds(bounds_, mesh.bounds_);
+  }
 }
 
 void Model::processNode(aiNode* node, const aiScene* scene) {
@@ -41,7 +54,6 @@ void Model::processNode(aiNode* node, const aiScene* scene) {
 Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
   std::vector<Vertex> vertices;
   std::vector<unsigned int> indices;
-  std::vector<Texture> textures;
 
   for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
     Vertex vertex;
@@ -77,26 +89,55 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
     }
   }
 
-  // process material
-  if (mesh->mMaterialIndex >= 0) {
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-    std::vector<Texture> diffuseMaps = loadMaterialTextures(
-        material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-    std::vector<Texture> specularMaps = loadMaterialTextures(
-        material, aiTextureType_SPECULAR, "texture_specular");
+  // reorder for the vertex cache, overdraw and vertex fetches
+  VertexCacheStats before = MeshOptimizer::analyzeVertexCache(
+      indices, vertices.size(), VERTEX_CACHE_ANALYZE_SIZE);
+  MeshOptimizer::optimizeVertexCache(indices, vertices.size());
+  MeshOptimizer::optimizeOverdraw(indices, vertices, OVERDRAW_ACMR_THRESHOLD);
+  MeshOptimizer::optimizeVertexFetch(vertices, indices);
+  VertexCacheStats after = MeshOptimizer::analyzeVertexCache(
+      indices, vertices.size(), VERTEX_CACHE_ANALYZE_SIZE);
+  std::ios::fmtflags flags = std::cout.flags();
+  std::streamsize precision = std::cout.precision();
+  std::cout << std::fixed << std::setprecision(2) << "Mesh " << meshes.size()
+            << ": ACMR " << before.acmr << " -> " << after.acmr << ", ATVR "
+            << before.atvr << " -> " << after.atvr << std::endl;
+  std::cout.flags(flags);
+  std::cout.precision(precision);
+
+  // process material, imported meshes are packed when precise enough. The
+  // vectors are moved, a copy would double the peak memory of the import.
+  return Mesh(std::move(vertices), std::move(indices),
+              getMaterial(scene, mesh->mMaterialIndex), VERTEX_FORMAT_PACKED,
+              retention_);
+}
 
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+std::shared_ptr<Material> Model::getMaterial(const aiScene* scene,
+                                             unsigned int index) {
+  if (index >= scene->mNumMaterials) {
+    return std::make_shared<Material>();
+  }
+  if (materials_.size() < scene->mNumMaterials) {
+    materials_.resize(scene->mNumMaterials);
   }
+  if (materials_[index]) {
+    return materials_[index];
+  }
+
+  aiMaterial* material = scene->mMaterials[index];
+  std::vector<Texture> textures = loadMaterialTextures(
+      material, aiTextureType_DIFFUSE, TEXTURE_DIFFUSE);
+  std::vector<Texture> specularMaps = loadMaterialTextures(
+      material, aiTextureType_SPECULAR, TEXTURE_SPECULAR);
+  textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 
-  return Mesh(vertices, indices, textures);
+  materials_[index] = std::make_shared<Material>(std::move(textures));
+  return materials_[index];
 }
 
 std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat,
                                                  aiTextureType type,
-                                                 std::string typeName) {
+                                                 TextureType textureType) {
   std::vector<Texture> textures;
   for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
     aiString str;
@@ -105,6 +146,8 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat,
     for (unsigned int j = 0; j < textures_loaded.size(); j++) {
       if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
         textures.push_back(textures_loaded[j]);
+        // the same image may fill a different slot in this material
+        textures.back().type = textureType;
         skip = true;
         break;
       }
@@ -112,7 +155,7 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat,
     if (!skip) {
       Texture texture;
       texture.id = loadTextureFromFile(str.C_Str(), directory);
-      texture.type = typeName;
+      texture.type = textureType;
       texture.path = str.C_Str();
       textures.push_back(texture);
       textures_loaded.push_back(texture);
@@ -6,30 +6,57 @@
 #include <assimp/Importer.hpp>
 
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "scene/instance_batcher.hpp"
 #include "scene/mesh.hpp"
-#include "shader.hpp"
+#include "shader_variants.hpp"
 
 class Model {
  public:
-  Model(const char* path);
+  /**
+   * @brief Loads a model
+   *
+   * @param path
+   * @param retention CPU data each mesh keeps after its upload
+   */
+  Model(const char* path, MeshRetention retention = MESH_RETAIN_NONE);
 
-  Model(const std::string& path) : Model(path.c_str()) {};
+  Model(const std::string& path, MeshRetention retention = MESH_RETAIN_NONE)
+      : Model(path.c_str(), retention) {};
+
+  /**
+   * @brief Adds an instance of each of the models meshes to `batcher`
+   *
+   * @param batcher
+   * @param model Model matrix
+   * @param normalMatrix inverse transpose of the upper 3x3 of `model`
+   */
+  void submit(InstanceBatcher& batcher,
+              const glm::mat4& model,
+              const glm::mat3& normalMatrix);
 
   /**
-   * @brief Draws all of the models meshes
+   * @brief Get the object space bounds of all meshes
    *
-   * @param shader
+   * @return const Bounds&
    */
-  void draw(Shader& shader);
+  const Bounds& getBounds() const { return bounds_; }
+
+  const std::vector<Mesh>& getMeshes() const { return meshes; }
 
  private:
   // model data
   std::vector<Mesh> meshes;
   std::string directory;
   std::vector<Texture> textures_loaded;
+  // one per assimp material, created on first use and shared by its meshes
+  std::vector<std::shared_ptr<Material>> materials_;
+  // union of the mesh bounds
+  Bounds bounds_;
+  MeshRetention retention_;
 
   /**
    * @brief Loads model with ASSIMP and recursively processes each Node
@@ -55,17 +82,28 @@ class Model {
    */
   Mesh processMesh(aiMesh* mesh, const aiScene* scene);
 
+  /**
+   * @brief Get the Material for an assimp material, loading its textures on
+   * first use
+   *
+   * @param scene
+   * @param index assimp material index
+   * @return std::shared_ptr<Material>
+   */
+  std::shared_ptr<Material> getMaterial(const aiScene* scene,
+                                        unsigned int index);
+
   /**
    * @brief Hanldes Texture loading
    *
    * @param mat
-   * @param type
-   * @param typeName
+   * @param type assimp texture type to load
+   * @param textureType slot the textures are used for
    * @return std::vector<Texture>
    */
   std::vector<Texture> loadMaterialTextures(aiMaterial* mat,
                                             aiTextureType type,
-                                            std::string typeName);
+                                            TextureType textureType);
 };
 
 #endif
\ No newline at end of file
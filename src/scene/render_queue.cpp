@@ -0,0 +1,68 @@
+#include "scene/render_queue.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+uint64_t makeSortKey(RenderPass pass,
+                     VariantKey variant,
+                     unsigned int textures,
+                     unsigned int geometry,
+                     float depth) {
+  const uint64_t depthMax = (1ull << SORT_KEY_DEPTH_BITS) - 1;
+  depth = std::min(std::max(depth, 0.0f), 1.0f);
+  uint64_t quantized = (uint64_t)(depth * depthMax);
+  if (pass == RENDER_PASS_TRANSPARENT) {
+    quantized = depthMax - quantized;
+  }
+
+  assert(textures < (1u << SORT_KEY_TEXTURES_BITS));
+  assert(geometry < (1u << SORT_KEY_GEOMETRY_BITS));
+
+  uint64_t key = (uint64_t)pass << SORT_KEY_PASS_SHIFT;
+  key |= (uint64_t)(variant & ((1u << SORT_KEY_VARIANT_BITS) - 1))
+         << SORT_KEY_VARIANT_SHIFT;
+  key |= (uint64_t)(textures & ((1u << SORT_KEY_TEXTURES_BITS) - 1))
+         << SORT_KEY_TEXTURES_SHIFT;
+  key |= (uint64_t)(geometry & ((1u << SORT_KEY_GEOMETRY_BITS) - 1))
+         << SORT_KEY_GEOMETRY_SHIFT;
+  return key | quantized;
+}
+
+void RenderQueue::sort() {
+  const unsigned int count = keys_.size();
+  if (count < 2) {
+    return;
+  }
+
+  // one histogram per key byte, all built in a single pass over the keys
+  unsigned int histograms[8][256] = {};
+  for (uint64_t key : keys_) {
+    for (int byte = 0; byte < 8; byte++) {
+      histograms[byte][(key >> (byte * 8)) & 0xff]++;
+    }
+  }
+
+  tempKeys_.resize(count);
+  tempValues_.resize(count);
+  for (int byte = 0; byte < 8; byte++) {
+    unsigned int* histogram = histograms[byte];
+    // every key has the same byte, the pass would not change the order
+    if (histogram[(keys_[0] >> (byte * 8)) & 0xff] == count) {
+      continue;
+    }
+
+    unsigned int offset = 0;
+    for (int digit = 0; digit < 256; digit++) {
+      unsigned int digitCount = histogram[digit];
+      histogram[digit] = offset;
+      offset += digitCount;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+      unsigned int target = histogram[(keys_[i] >> (byte * 8)) & 0xff]++;
+      tempKeys_[target] = keys_[i];
+      tempValues_[target] = values_[i];
+    }
+    keys_.swap(tempKeys_);
+    values_.swap(tempValues_);
+  }
+}
@@ -0,0 +1,112 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "shader_variants.hpp"
+
+/**
+ * @brief Bit layout of a 64 bit draw sort key, most significant first.
+ *
+ * bits 62-63 pass, passes are drawn in order
+ * bits 56-61 material bits of the shader `VariantKey` (program)
+ * bits 42-55 texture set id
+ * bits 26-41 geometry id (VAO)
+ * bits 0-25  quantized depth
+ *
+ * Sorting by key groups draws by the most expensive state first, draws
+ * with equal state are ordered by depth.
+ */
+constexpr unsigned int SORT_KEY_DEPTH_BITS = 26;
+constexpr unsigned int SORT_KEY_GEOMETRY_BITS = 16;
+constexpr unsigned int SORT_KEY_TEXTURES_BITS = 14;
+constexpr unsigned int SORT_KEY_VARIANT_BITS = 6;
+
+constexpr unsigned int SORT_KEY_GEOMETRY_SHIFT = SORT_KEY_DEPTH_BITS;
+constexpr unsigned int SORT_KEY_TEXTURES_SHIFT =
+    SORT_KEY_GEOMETRY_SHIFT + SORT_KEY_GEOMETRY_BITS;
+constexpr unsigned int SORT_KEY_VARIANT_SHIFT =
+    SORT_KEY_TEXTURES_SHIFT + SORT_KEY_TEXTURES_BITS;
+constexpr unsigned int SORT_KEY_PASS_SHIFT =
+    SORT_KEY_VARIANT_SHIFT + SORT_KEY_VARIANT_BITS;
+
+enum RenderPass {
+  // drawn front to back, so early depth testing rejects hidden fragments
+  RENDER_PASS_OPAQUE,
+  // drawn back to front
+  RENDER_PASS_TRANSPARENT,
+};
+
+/**
+ * @brief Packs the state of one draw into a sort key. Ids wider than their
+ * field are a bug of the caller, asserted in debug builds.
+ *
+ * @param pass
+ * @param variant material bits of the shader variant
+ * @param textures texture set id
+ * @param geometry geometry id
+ * @param depth normalized view depth in [0, 1]
+ * @return uint64_t
+ */
+uint64_t makeSortKey(RenderPass pass,
+                     VariantKey variant,
+                     unsigned int textures,
+                     unsigned int geometry,
+                     float depth);
+
+/**
+ * @brief Draw items of one frame, each a 64 bit key and a payload index,
+ * sorted by key with an LSD radix sort.
+ *
+ * Radix sorting is linear in the number of items. Key bytes that are the
+ * same for every item (e.g. the pass while there is only one) are skipped.
+ */
+class RenderQueue {
+ public:
+  /**
+   * @brief Removes all items, keeping the allocations
+   *
+   */
+  void clear() {
+    keys_.clear();
+    values_.clear();
+  }
+
+  /**
+   * @brief Appends an item
+   *
+   * @param key
+   * @param value payload, usually an index into the caller's draw data
+   */
+  void push(uint64_t key, uint32_t value) {
+    keys_.push_back(key);
+    values_.push_back(value);
+  }
+
+  /**
+   * @brief Sorts the items by ascending key, items with equal keys keep
+   * their order
+   *
+   */
+  void sort();
+
+  /**
+   * @brief Get the number of items
+   *
+   * @return unsigned int
+   */
+  unsigned int size() const { return keys_.size(); }
+
+  uint64_t getKey(unsigned int i) const { return keys_[i]; }
+  uint32_t getValue(unsigned int i) const { return values_[i]; }
+
+ private:
+  std::vector<uint64_t> keys_;
+  std::vector<uint32_t> values_;
+  // scatter targets of the radix passes
+  std::vector<uint64_t> tempKeys_;
+  std::vector<uint32_t> tempValues_;
+};
+
+#endif
@@ -1,7 +1,269 @@
 #include "scene.hpp"
 
-void Scene::addEntity(std::unique_ptr<Entity> entity) {
-  rootEntities_.push_back(std::move(entity));
+#include <algorithm>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <iostream>
+
+MeshEntity Scene::addMeshEntity(std::shared_ptr<Mesh> mesh,
+                                const Transform& transform,
+                                EntityHandle parent) {
+  EntityHandle handle = entities_.addMesh(std::move(mesh), transform,
+                                          parentIndexOf(parent));
+  onEntityAdded();
+  return MeshEntity(this, handle);
+}
+
+MeshEntity Scene::addMeshEntity(std::shared_ptr<Mesh> mesh,
+                                const Transform& transform,
+                                const glm::vec3& color,
+                                EntityHandle parent) {
+  MeshEntity entity = addMeshEntity(std::move(mesh), transform, parent);
+  entity.setColor(color);
+  return entity;
+}
+
+ModelEntity Scene::addModelEntity(std::shared_ptr<Model> model,
+                                  const Transform& transform,
+                                  EntityHandle parent) {
+  EntityHandle handle = entities_.addModel(std::move(model), transform,
+                                           parentIndexOf(parent));
+  onEntityAdded();
+  return ModelEntity(this, handle);
+}
+
+unsigned int Scene::parentIndexOf(EntityHandle parent) const {
+  if (parent == EntityHandle()) {
+    return ENTITY_NO_PARENT;
+  }
+  unsigned int index = entities_.indexOf(parent);
+  if (index == ENTITY_INVALID) {
+    std::cout << "ERROR::SCENE::INVALID_PARENT: stale handle" << std::endl;
+    return ENTITY_NO_PARENT;
+  }
+  return index;
+}
+
+void Scene::onEntityAdded() {
+  // append a slot after all others, the parent already has one so it still
+  // comes first. The world data is computed by the next update.
+  unsigned int id = entities_.size() - 1;
+  unsigned int slot = order_.size();
+  order_.push_back(id);
+  slotOf_.push_back(slot);
+  subtreeSizes_.push_back(1);
+  worldMatrices_.emplace_back(1.0f);
+  normalMatrices_.emplace_back(1.0f);
+  dirtyFlags_.push_back(false);
+  markDirty(slot);
+  if (entities_.parents_[id] != ENTITY_NO_PARENT) {
+    appendedChildren_ = true;
+  }
+  structuralChanges_++;
+}
+
+void Scene::markDirty(unsigned int slot) {
+  if (!dirtyFlags_[slot]) {
+    dirtyFlags_[slot] = true;
+    dirtySlots_.push_back(slot);
+  }
+}
+
+bool Scene::removeEntity(EntityHandle entity) {
+  unsigned int index = entities_.indexOf(entity);
+  if (index == ENTITY_INVALID) {
+    return false;
+  }
+
+  // collect the subtree parents first, then remove it from the leaves up so
+  // no entity is orphaned on the way. Removal moves entities around, so go
+  // through their handles.
+  std::vector<EntityHandle> subtree;
+  std::vector<unsigned int> stack(1, index);
+  while (!stack.empty()) {
+    unsigned int id = stack.back();
+    stack.pop_back();
+    subtree.push_back(entities_.handles_[id]);
+    const std::vector<unsigned int>& children = entities_.children_[id];
+    stack.insert(stack.end(), children.begin(), children.end());
+  }
+  for (auto it = subtree.rbegin(); it != subtree.rend(); ++it) {
+    unsigned int id = entities_.indexOf(*it);
+    unsigned int last = entities_.size() - 1;
+    // leave a hole in the traversal order, no other slot moves
+    order_[slotOf_[id]] = SCENE_EMPTY_SLOT;
+    bvh_.remove(id);
+    entities_.remove(id);
+    if (id != last) {
+      // the store moved the last entity to `id`
+      slotOf_[id] = slotOf_[last];
+      order_[slotOf_[id]] = id;
+      bvh_.rename(last, id);
+    }
+    slotOf_.pop_back();
+    structuralChanges_++;
+  }
+  return true;
+}
+
+bool Scene::setTransform(EntityHandle entity, const Transform& transform) {
+  unsigned int id = entities_.indexOf(entity);
+  if (id == ENTITY_INVALID) {
+    return false;
+  }
+  entities_.transforms_[id] = transform;
+  entities_.localMatrices_[id] = transform.getModelMatrix();
+  markDirty(slotOf_[id]);
+  return true;
+}
+
+glm::mat4 Scene::getWorldMatrix(EntityHandle entity) {
+  unsigned int id = entities_.indexOf(entity);
+  if (id == ENTITY_INVALID) {
+    return glm::mat4(1.0f);
+  }
+  updateWorld();
+  return worldMatrices_[slotOf_[id]];
+}
+
+bool Scene::raycast(const glm::vec3& origin,
+                    const glm::vec3& direction,
+                    float maxDistance,
+                    EntityHandle& entity,
+                    float& distance) {
+  updateWorld();
+  BvhRayHit hit;
+  if (!bvh_.raycast(origin, direction, maxDistance, hit)) {
+    return false;
+  }
+  entity = entities_.handles_[hit.primitive];
+  distance = hit.distance;
+  return true;
+}
+
+void Scene::updateWorld() {
+  // holes and appended entities degrade the traversal order and the BVH,
+  // lay everything out again once they make up a good part of the scene
+  unsigned int rebuildChanges =
+      SCENE_REBUILD_MIN_CHANGES +
+      static_cast<unsigned int>(entities_.size() * SCENE_REBUILD_FRACTION);
+  if (structuralChanges_ > rebuildChanges) {
+    relayout();
+    return;
+  }
+
+  if (dirtySlots_.empty()) {
+    return;
+  }
+
+  // update each dirty subtree once, a dirty entity inside an already
+  // updated subtree is covered by it
+  std::vector<unsigned int>& slots = dirtySlots_;
+  for (unsigned int slot : slots) {
+    dirtyFlags_[slot] = false;
+  }
+  std::sort(slots.begin(), slots.end());
+  unsigned int updatedEnd = 0;
+  for (unsigned int slot : slots) {
+    if (slot < updatedEnd || order_[slot] == SCENE_EMPTY_SLOT) {
+      continue;
+    }
+    updatedEnd = slot + subtreeSizes_[slot];
+    updateSubtree(slot);
+  }
+  dirtySlots_.clear();
+}
+
+void Scene::relayout() {
+  // rebuild the depth first order, roots in the order they were added
+  unsigned int count = entities_.size();
+  order_.clear();
+  slotOf_.resize(count);
+  std::vector<unsigned int> stack;
+  for (unsigned int root = 0; root < count; root++) {
+    if (entities_.parents_[root] != ENTITY_NO_PARENT) {
+      continue;
+    }
+    stack.push_back(root);
+    while (!stack.empty()) {
+      unsigned int id = stack.back();
+      stack.pop_back();
+      slotOf_[id] = order_.size();
+      order_.push_back(id);
+      const std::vector<unsigned int>& children = entities_.children_[id];
+      for (auto it = children.rbegin(); it != children.rend(); ++it) {
+        stack.push_back(*it);
+      }
+    }
+  }
+  // children come after their parent, so a reverse sweep sums up subtrees
+  subtreeSizes_.assign(count, 1);
+  for (unsigned int slot = count; slot-- > 0;) {
+    unsigned int parent = entities_.parents_[order_[slot]];
+    if (parent != ENTITY_NO_PARENT) {
+      subtreeSizes_[slotOf_[parent]] += subtreeSizes_[slot];
+    }
+  }
+
+  worldMatrices_.resize(count);
+  normalMatrices_.resize(count);
+  updateWorldRange(0, count, false);
+  bvh_.build(entities_.worldBounds_);
+
+  dirtyFlags_.assign(count, false);
+  dirtySlots_.clear();
+  structuralChanges_ = 0;
+  appendedChildren_ = false;
+}
+
+void Scene::updateSubtree(unsigned int slot) {
+  unsigned int end = slot + subtreeSizes_[slot];
+  updateWorldRange(slot, end, true);
+  if (!appendedChildren_) {
+    return;
+  }
+
+  // children added since the last relayout sit after the range
+  for (unsigned int s = slot; s < end; s++) {
+    unsigned int id = order_[s];
+    if (id == SCENE_EMPTY_SLOT) {
+      continue;
+    }
+    for (unsigned int child : entities_.children_[id]) {
+      if (slotOf_[child] >= end) {
+        updateSubtree(slotOf_[child]);
+      }
+    }
+  }
+}
+
+void Scene::updateWorldRange(unsigned int begin,
+                             unsigned int end,
+                             bool updateBvh) {
+  const std::vector<unsigned int>& parents = entities_.parents_;
+  const std::vector<glm::mat4>& localMatrices = entities_.localMatrices_;
+  const std::vector<Bounds>& localBounds = entities_.localBounds_;
+  std::vector<Bounds>& worldBounds = entities_.worldBounds_;
+
+  for (unsigned int slot = begin; slot < end; slot++) {
+    unsigned int id = order_[slot];
+    if (id == SCENE_EMPTY_SLOT) {
+      continue;
+    }
+    unsigned int parent = parents[id];
+    if (parent == ENTITY_NO_PARENT) {
+      worldMatrices_[slot] = localMatrices[id];
+    } else {
+      worldMatrices_[slot] =
+          worldMatrices_[slotOf_[parent]] * localMatrices[id];
+    }
+    normalMatrices_[slot] =
+        glm::inverseTranspose(glm::mat3(worldMatrices_[slot]));
+
+    worldBounds[id] = transformBounds(localBounds[id], worldMatrices_[slot]);
+    if (updateBvh) {
+      bvh_.insert(id, worldBounds[id]);
+    }
+  }
 }
 
 std::shared_ptr<Mesh> Scene::getOrCreateMesh(const std::string& key) {
@@ -18,19 +280,59 @@ std::shared_ptr<Mesh> Scene::getOrCreateMesh(const std::string& key) {
   return mesh;
 }
 
-std::shared_ptr<Model> Scene::getOrCreateModel(const std::string& path) {
+std::shared_ptr<Model> Scene::getOrCreateModel(const std::string& path,
+                                               MeshRetention retention) {
   auto it = modelCache_.find(path);
   if (it != modelCache_.end()) {
     return it->second;
   }
 
-  std::shared_ptr<Model> model = std::make_shared<Model>(path);
+  std::shared_ptr<Model> model = std::make_shared<Model>(path, retention);
   modelCache_[path] = model;
   return model;
 }
 
-void Scene::draw(Shader& shader) const {
-  for (auto& entity : rootEntities_) {
-    entity->draw(shader);
+size_t Scene::getIndexMemorySaved() const {
+  size_t saved = 0;
+  auto addMesh = [&saved](const Mesh& mesh) {
+    saved += mesh.getIndexCount() * sizeof(unsigned int) -
+             mesh.getIndexBufferSize();
+  };
+  for (const auto& entry : meshCache_) {
+    if (entry.second) {
+      addMesh(*entry.second);
+    }
+  }
+  for (const auto& entry : modelCache_) {
+    for (const Mesh& mesh : entry.second->getMeshes()) {
+      addMesh(mesh);
+    }
+  }
+  return saved;
+}
+
+void Scene::draw(ShaderVariants& shaders,
+                 const Frustum& frustum,
+                 RingBuffer& ring) {
+  updateWorld();
+  visibleEntities_.clear();
+  bvh_.cull(frustum, visibleEntities_);
+  visibleEntityCount_ = visibleEntities_.size();
+
+  // build the draw list from the component arrays
+  batcher_.clear(frustum);
+  for (unsigned int id : visibleEntities_) {
+    unsigned int slot = slotOf_[id];
+    const glm::mat4& world = worldMatrices_[slot];
+    const glm::mat3& normalMatrix = normalMatrices_[slot];
+    if (Model* model = entities_.models_[id].get()) {
+      model->submit(batcher_, world, normalMatrix);
+    } else if (entities_.useColor_[id]) {
+      batcher_.add(entities_.meshes_[id].get(), world, normalMatrix,
+                   entities_.colors_[id]);
+    } else {
+      batcher_.add(entities_.meshes_[id].get(), world, normalMatrix);
+    }
   }
+  batcher_.draw(shaders, ring);
 }
\ No newline at end of file
@@ -5,24 +5,125 @@
 #include <unordered_map>
 #include <vector>
 
+#include "frustum.hpp"
+#include "scene/bvh.hpp"
 #include "scene/entitiy.hpp"
+#include "scene/entity_store.hpp"
+#include "scene/instance_batcher.hpp"
 #include "scene/mesh_factory.hpp"
-#include "shader.hpp"
+#include "shader_variants.hpp"
+
+// entities added plus removed since the last full relayout before the next
+// one, on top of `SCENE_REBUILD_FRACTION` of the entity count
+constexpr unsigned int SCENE_REBUILD_MIN_CHANGES = 256;
+constexpr float SCENE_REBUILD_FRACTION = 0.25f;
+// traversal slot of a removed entity
+constexpr unsigned int SCENE_EMPTY_SLOT = 0xffffffff;
 
 class Scene {
  public:
-  std::vector<std::unique_ptr<Entity>> rootEntities_;
+  // components of all entities, indexed by dense entity index
+  EntityStore entities_;
   // cache and reuse mesh info for duplicate objects
   std::unordered_map<std::string, std::shared_ptr<Mesh>> meshCache_;
   // cache and reuse model info for duplicate objects
   std::unordered_map<std::string, std::shared_ptr<Model>> modelCache_;
 
   /**
-   * @brief Adds an `Entity` to `rootEntities_` and thereby to the Scene
+   * @brief Adds an entity rendering a textured Mesh
+   *
+   * @param mesh
+   * @param transform relative to the parent
+   * @param parent parent entity, a default handle for a root
+   * @return MeshEntity
+   */
+  MeshEntity addMeshEntity(std::shared_ptr<Mesh> mesh,
+                           const Transform& transform,
+                           EntityHandle parent = EntityHandle());
+
+  /**
+   * @brief Adds an entity rendering a mono colored Mesh
+   *
+   * @param mesh
+   * @param transform relative to the parent
+   * @param color
+   * @param parent parent entity, a default handle for a root
+   * @return MeshEntity
+   */
+  MeshEntity addMeshEntity(std::shared_ptr<Mesh> mesh,
+                           const Transform& transform,
+                           const glm::vec3& color,
+                           EntityHandle parent = EntityHandle());
+
+  /**
+   * @brief Adds an entity rendering a Model
+   *
+   * @param model
+   * @param transform relative to the parent
+   * @param parent parent entity, a default handle for a root
+   * @return ModelEntity
+   */
+  ModelEntity addModelEntity(std::shared_ptr<Model> model,
+                             const Transform& transform,
+                             EntityHandle parent = EntityHandle());
+
+  /**
+   * @brief Removes an entity together with all its descendants.
+   *
+   * Each removed entity leaves a hole in the traversal order and is taken
+   * out of the BVH in O(depth). Handles to removed entities become invalid.
+   *
+   * @param entity
+   * @return true if the entity existed
+   */
+  bool removeEntity(EntityHandle entity);
+
+  /**
+   * @brief Check if `entity` refers to an entity of this Scene that has not
+   * been removed
+   *
+   * @param entity
+   * @return bool
+   */
+  bool isValid(EntityHandle entity) const { return entities_.isValid(entity); }
+
+  /**
+   * @brief Changes the transform of an entity relative to its parent
+   *
+   * Entity transforms must be changed through this. The world matrices of
+   * the entity and its descendants are recomputed before the next draw or
+   * query, everything else keeps its cached matrices.
+   *
+   * @param entity
+   * @param transform
+   * @return false if the handle is stale
+   */
+  bool setTransform(EntityHandle entity, const Transform& transform);
+
+  /**
+   * @brief Get the world matrix of an entity
    *
    * @param entity
+   * @return glm::mat4 a copy, the cached matrices move when entities are
+   * added or removed. Identity if the handle is stale.
+   */
+  glm::mat4 getWorldMatrix(EntityHandle entity);
+
+  /**
+   * @brief Finds the closest entity whose world bounds are hit by a ray
+   *
+   * @param origin
+   * @param direction normalized
+   * @param maxDistance
+   * @param entity set to the hit entity
+   * @param distance set to the distance along the ray
+   * @return true if an entity was hit
    */
-  void addEntity(std::unique_ptr<Entity> entity);
+  bool raycast(const glm::vec3& origin,
+               const glm::vec3& direction,
+               float maxDistance,
+               EntityHandle& entity,
+               float& distance);
 
   /**
    * @brief Get or create the Mesh object
@@ -36,17 +137,158 @@ class Scene {
    * @brief Get or create the Model object
    *
    * @param path
+   * @param retention CPU data the meshes keep, used when the model is first
+   * loaded
    * @return std::shared_ptr<Model>
    */
-  std::shared_ptr<Model> getOrCreateModel(const std::string& path);
+  std::shared_ptr<Model> getOrCreateModel(
+      const std::string& path,
+      MeshRetention retention = MESH_RETAIN_NONE);
 
   /**
-   * @brief Draws entire Scene defined by `rootEntities` and their children.
+   * @brief Draws entire Scene defined by `entities_`.
+   *
+   * Entities outside of `frustum` are skipped, found by walking the
+   * bounding volume hierarchy.
+   * Entities sharing a cached Mesh or Model are drawn with one instanced
+   * draw call per mesh, sorted by state and front to back.
    *
+   * @param shaders Shader permutations, each mesh selects its variant
+   * @param frustum world space camera frustum
+   * @param ring receives the frame's instance data
    */
-  void draw(Shader& shader) const;
+  void draw(ShaderVariants& shaders, const Frustum& frustum, RingBuffer& ring);
+
+  /**
+   * @brief Get the number of entities that passed culling in the last
+   * `draw()`
+   *
+   * @return unsigned int
+   */
+  unsigned int getVisibleEntityCount() const { return visibleEntityCount_; }
+
+  /**
+   * @brief Get the number of entities in the Scene
+   *
+   * @return unsigned int
+   */
+  unsigned int getEntityCount() const { return entities_.size(); }
+
+  /**
+   * @brief Get the bytes the cached meshes and models save by using 16 bit
+   * instead of 32 bit index buffers
+   *
+   * @return size_t
+   */
+  size_t getIndexMemorySaved() const;
+
+  /**
+   * @brief Draw through one multi-draw-indirect call per shader/texture
+   * bucket over a shared geometry buffer, see `InstanceBatcher`
+   *
+   * @param multiDraw
+   */
+  void setMultiDraw(bool multiDraw) { batcher_.setMultiDraw(multiDraw); }
+
+  /**
+   * @brief Sample all materials from texture arrays through a material
+   * buffer, see `InstanceBatcher`
+   *
+   * @param materialArrays
+   */
+  void setMaterialArrays(bool materialArrays) {
+    batcher_.setMaterialArrays(materialArrays);
+  }
+
+  /**
+   * @brief Get the instance batches of the last `draw()`
+   *
+   * @return const InstanceBatcher&
+   */
+  const InstanceBatcher& getBatcher() const { return batcher_; }
 
  private:
+  InstanceBatcher batcher_;
+
+  // traversal order: slot -> entity id, `SCENE_EMPTY_SLOT` for removed
+  // entities. The last relayout put the descendants of the entity in slot s
+  // into the slots (s, s + subtreeSizes_[s]), entities added since then are
+  // appended after all of them.
+  std::vector<unsigned int> order_;
+  std::vector<unsigned int> slotOf_;
+  std::vector<unsigned int> subtreeSizes_;
+  // per slot, parents always come before their children
+  std::vector<glm::mat4> worldMatrices_;
+  std::vector<glm::mat3> normalMatrices_;
+
+  // slots whose transform changed or that were added since the last update
+  std::vector<unsigned int> dirtySlots_;
+  std::vector<bool> dirtyFlags_;
+  // entities added or removed since the last relayout
+  unsigned int structuralChanges_ = 0;
+  // set when a child was appended outside of its parent's slot range
+  bool appendedChildren_ = false;
+
+  // over `entities_.worldBounds_`, updated in place between relayouts
+  Bvh bvh_;
+
+  // indices of the entities that passed culling in the last draw
+  std::vector<unsigned int> visibleEntities_;
+  unsigned int visibleEntityCount_ = 0;
+
+  /**
+   * @brief Brings world matrices, bounds and `bvh_` up to date. Does no
+   * matrix math if nothing changed since the last call.
+   *
+   */
+  void updateWorld();
+
+  /**
+   * @brief Lays out the traversal order depth first without holes and
+   * builds `bvh_` from scratch
+   *
+   */
+  void relayout();
+
+  /**
+   * @brief Recomputes the world data of the entity in `slot` and all its
+   * descendants, including those appended after its slot range
+   *
+   * @param slot
+   */
+  void updateSubtree(unsigned int slot);
+
+  /**
+   * @brief Recomputes the world matrices and bounds of the slots
+   * [begin, end), their parents must be up to date
+   *
+   * @param begin
+   * @param end
+   * @param updateBvh insert the entities into `bvh_` or refit them
+   */
+  void updateWorldRange(unsigned int begin, unsigned int end, bool updateBvh);
+
+  /**
+   * @brief Gives the entity just appended to `entities_` a slot at the end
+   * of the traversal order
+   *
+   */
+  void onEntityAdded();
+
+  /**
+   * @brief Queues `slot` for the next update
+   *
+   * @param slot
+   */
+  void markDirty(unsigned int slot);
+
+  /**
+   * @brief Resolves the parent handle passed to the add functions
+   *
+   * @param parent
+   * @return unsigned int dense index, `ENTITY_NO_PARENT` for a root
+   */
+  unsigned int parentIndexOf(EntityHandle parent) const;
 };
 
 #endif
\ No newline at end of file
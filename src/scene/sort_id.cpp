@@ -0,0 +1,47 @@
+#include "scene/sort_id.hpp"
+
+uint32_t SortIdPool::acquire() {
+  if (!freeIndices_.empty()) {
+    uint32_t index = freeIndices_.back();
+    freeIndices_.pop_back();
+    return index;
+  }
+  generations_.push_back(1);
+  return generations_.size() - 1;
+}
+
+void SortIdPool::release(uint32_t index) {
+  generations_[index]++;
+  freeIndices_.push_back(index);
+}
+
+SortId::SortId(SortIdPool& pool) : pool_(&pool) {
+  index_ = pool.acquire();
+  generation_ = pool.getGeneration(index_);
+}
+
+SortId::~SortId() {
+  if (pool_) {
+    pool_->release(index_);
+  }
+}
+
+SortId::SortId(SortId&& other) noexcept
+    : pool_(other.pool_),
+      index_(other.index_),
+      generation_(other.generation_) {
+  other.pool_ = nullptr;
+}
+
+SortId& SortId::operator=(SortId&& other) noexcept {
+  if (this != &other) {
+    if (pool_) {
+      pool_->release(index_);
+    }
+    pool_ = other.pool_;
+    index_ = other.index_;
+    generation_ = other.generation_;
+    other.pool_ = nullptr;
+  }
+  return *this;
+}
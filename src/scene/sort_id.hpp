@@ -0,0 +1,78 @@
+#ifndef SORT_ID_H
+#define SORT_ID_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Hands out small indices for the fields of draw sort keys and
+ * recycles them through a free list.
+ *
+ * Every index has a generation that is bumped when the index is released,
+ * so tables indexed by it can tell an entry of a destroyed object from one
+ * of the object that reuses the index. Generations start at 1, 0 never
+ * matches a live id.
+ */
+class SortIdPool {
+ public:
+  /**
+   * @brief Takes a released index if there is one, else the next new one
+   *
+   * @return uint32_t
+   */
+  uint32_t acquire();
+
+  /**
+   * @brief Returns `index` to the free list and bumps its generation
+   *
+   * @param index
+   */
+  void release(uint32_t index);
+
+  /**
+   * @brief Get the current generation of an acquired index
+   *
+   * @param index
+   * @return uint32_t
+   */
+  uint32_t getGeneration(uint32_t index) const { return generations_[index]; }
+
+ private:
+  std::vector<uint32_t> generations_;
+  std::vector<uint32_t> freeIndices_;
+};
+
+/**
+ * @brief Sort id owned by a `Mesh` or `Material`, released when the owner
+ * is destroyed.
+ *
+ * Move only, a moved from id owns nothing.
+ */
+class SortId {
+ public:
+  /**
+   * @brief Acquires an index from `pool`
+   *
+   * @param pool must outlive the id
+   */
+  explicit SortId(SortIdPool& pool);
+
+  ~SortId();
+
+  SortId(const SortId&) = delete;
+  SortId& operator=(const SortId&) = delete;
+
+  SortId(SortId&& other) noexcept;
+  SortId& operator=(SortId&& other) noexcept;
+
+  uint32_t getIndex() const { return index_; }
+  uint32_t getGeneration() const { return generation_; }
+
+ private:
+  // nullptr once moved from
+  SortIdPool* pool_;
+  uint32_t index_;
+  uint32_t generation_;
+};
+
+#endif
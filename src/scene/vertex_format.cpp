@@ -0,0 +1,115 @@
+#include "scene/vertex_format.hpp"
+
+#include <glad/glad.h>
+
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+/**
+ * @brief Maps a unit vector onto the octahedron and unfolds it into
+ * [-1, 1]^2
+ *
+ * @param n normalized
+ * @return glm::vec2
+ */
+static glm::vec2 encodeOctahedral(const glm::vec3& n) {
+  glm::vec2 p =
+      glm::vec2(n.x, n.y) / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+  if (n.z < 0.0f) {
+    glm::vec2 folded = glm::vec2(1.0f - std::abs(p.y), 1.0f - std::abs(p.x));
+    p.x = p.x >= 0.0f ? folded.x : -folded.x;
+    p.y = p.y >= 0.0f ? folded.y : -folded.y;
+  }
+  return p;
+}
+
+size_t getVertexSize(VertexFormat format) {
+  return format == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex)
+                                        : sizeof(Vertex);
+}
+
+void setupVertexAttributes(unsigned int vertexArray, VertexFormat format) {
+  for (unsigned int attribute = 0; attribute < 3; attribute++) {
+    glEnableVertexArrayAttrib(vertexArray, attribute);
+    glVertexArrayAttribBinding(vertexArray, attribute, 0);
+  }
+  if (format == VERTEX_FORMAT_PACKED) {
+    glVertexArrayAttribFormat(vertexArray, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+                              offsetof(PackedVertex, position));
+    // decoded to a unit vector in the vertex shader (PACKED_VERTICES)
+    glVertexArrayAttribFormat(vertexArray, 1, 2, GL_SHORT, GL_TRUE,
+                              offsetof(PackedVertex, normal));
+    glVertexArrayAttribFormat(vertexArray, 2, 2, GL_HALF_FLOAT, GL_FALSE,
+                              offsetof(PackedVertex, texCoords));
+  } else {
+    glVertexArrayAttribFormat(vertexArray, 0, 3, GL_FLOAT, GL_FALSE,
+                              offsetof(Vertex, position));
+    glVertexArrayAttribFormat(vertexArray, 1, 3, GL_FLOAT, GL_FALSE,
+                              offsetof(Vertex, normal));
+    glVertexArrayAttribFormat(vertexArray, 2, 2, GL_FLOAT, GL_FALSE,
+                              offsetof(Vertex, texCoords));
+  }
+}
+
+unsigned int getIndexType(size_t vertexCount) {
+  return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+size_t getIndexSize(unsigned int type) {
+  switch (type) {
+    case GL_UNSIGNED_BYTE:
+      return 1;
+    case GL_UNSIGNED_SHORT:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+bool packVertices(const Vertex* vertices,
+                  size_t count,
+                  const Bounds& bounds,
+                  std::vector<PackedVertex>& packed,
+                  glm::mat4& dequantize) {
+  glm::vec3 extent = bounds.max - bounds.min;
+  // flat axes would divide by zero, every position has the minimum there
+  glm::vec3 scale;
+  for (int axis = 0; axis < 3; axis++) {
+    scale[axis] = extent[axis] > 0.0f ? 65535.0f / extent[axis] : 0.0f;
+  }
+
+  packed.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    const Vertex& vertex = vertices[i];
+    PackedVertex& out = packed[i];
+
+    for (int axis = 0; axis < 3; axis++) {
+      float q = std::round((vertex.position[axis] - bounds.min[axis]) *
+                           scale[axis]);
+      out.position[axis] = (uint16_t)glm::clamp(q, 0.0f, 65535.0f);
+      float decoded = bounds.min[axis] +
+                      out.position[axis] * (extent[axis] / 65535.0f);
+      if (std::abs(decoded - vertex.position[axis]) >
+          PACKED_MAX_POSITION_ERROR) {
+        return false;
+      }
+    }
+    out.pad = 0;
+
+    uint32_t normal = glm::packSnorm2x16(encodeOctahedral(vertex.normal));
+    out.normal[0] = (int16_t)(normal & 0xffff);
+    out.normal[1] = (int16_t)(normal >> 16);
+
+    uint32_t texCoords = glm::packHalf2x16(vertex.texCoords);
+    glm::vec2 decoded = glm::unpackHalf2x16(texCoords);
+    if (std::abs(decoded.x - vertex.texCoords.x) > PACKED_MAX_TEXCOORD_ERROR ||
+        std::abs(decoded.y - vertex.texCoords.y) > PACKED_MAX_TEXCOORD_ERROR) {
+      return false;
+    }
+    out.texCoords[0] = (uint16_t)(texCoords & 0xffff);
+    out.texCoords[1] = (uint16_t)(texCoords >> 16);
+  }
+
+  dequantize = glm::scale(glm::translate(glm::mat4(1.0f), bounds.min), extent);
+  return true;
+}
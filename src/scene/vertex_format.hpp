@@ -0,0 +1,98 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "bounds.hpp"
+
+// largest position error accepted for `VERTEX_FORMAT_PACKED`, in object
+// space units
+constexpr float PACKED_MAX_POSITION_ERROR = 1e-3f;
+// largest texture coordinate error accepted for `VERTEX_FORMAT_PACKED`,
+// a quarter texel of a 1024 texture
+constexpr float PACKED_MAX_TEXCOORD_ERROR = 1.0f / 4096.0f;
+
+struct Vertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 texCoords;
+};
+
+/**
+ * @brief Compressed `Vertex`, half the size.
+ *
+ * Positions are 16 bit unorm relative to the mesh bounds (decoded by the
+ * matrix returned from `packVertices()`), normals are octahedral encoded as
+ * 2 x 16 bit snorm and texture coordinates are half floats.
+ */
+struct PackedVertex {
+  uint16_t position[3];
+  uint16_t pad;
+  int16_t normal[2];
+  uint16_t texCoords[2];
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must be 16 bytes");
+
+enum VertexFormat { VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_PACKED };
+
+/**
+ * @brief Get the size of one vertex in bytes
+ *
+ * @param format
+ * @return size_t
+ */
+size_t getVertexSize(VertexFormat format);
+
+/**
+ * @brief Sets up attributes 0 (position), 1 (normal) and 2 (texture
+ * coordinates) of `vertexArray` to read `format` from vertex buffer
+ * binding 0
+ *
+ * @param vertexArray
+ * @param format
+ */
+void setupVertexAttributes(unsigned int vertexArray, VertexFormat format);
+
+/**
+ * @brief Get the smallest index type able to address `vertexCount` vertices
+ *
+ * 8 bit indices are not used, they are converted by the driver on a lot of
+ * hardware.
+ *
+ * @param vertexCount
+ * @return unsigned int `GL_UNSIGNED_SHORT` or `GL_UNSIGNED_INT`
+ */
+unsigned int getIndexType(size_t vertexCount);
+
+/**
+ * @brief Get the size of one index in bytes
+ *
+ * @param type `GL_UNSIGNED_BYTE`, `GL_UNSIGNED_SHORT` or `GL_UNSIGNED_INT`
+ * @return size_t
+ */
+size_t getIndexSize(unsigned int type);
+
+/**
+ * @brief Compresses vertices to `PackedVertex`, unless that would move a
+ * position by more than `PACKED_MAX_POSITION_ERROR` or a texture coordinate
+ * by more than `PACKED_MAX_TEXCOORD_ERROR`
+ *
+ * @param vertices
+ * @param count
+ * @param bounds of the vertex positions
+ * @param packed filled with `count` vertices
+ * @param dequantize set to the matrix mapping the decoded unorm positions
+ * back to object space
+ * @return true if the vertices were packed within the error bounds
+ */
+bool packVertices(const Vertex* vertices,
+                  size_t count,
+                  const Bounds& bounds,
+                  std::vector<PackedVertex>& packed,
+                  glm::mat4& dequantize);
+
+#endif
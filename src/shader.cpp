@@ -1,74 +1,199 @@
 #include "shader.hpp"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
-  // 1. retrieve the source code from filePath
-  std::string vertexCode;
-  std::string fragmentCode;
-  std::ifstream vShaderFile;
-  std::ifstream fShaderFile;
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "gl_state.hpp"
+
+UniformStats Shader::stats_;
+
+// sampler uniform of each `TextureType`
+static const char* const MATERIAL_SAMPLER_NAMES[TEXTURE_TYPE_COUNT] = {
+    "material.texture_diffuse1", "material.texture_specular1"};
+
+// magic number at the start of cached program binaries ("SGLB")
+static const uint32_t PROGRAM_BINARY_MAGIC = 0x424c4753;
+
+// FNV-1a, used to hash uniform names and shader cache keys
+static uint64_t hashBytes(const char* str,
+                          size_t length,
+                          uint64_t hash = 14695981039346656037ull) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)str[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static uint64_t hashName(const char* str, size_t length) {
+  return hashBytes(str, length);
+}
+
+static uint64_t hashString(const std::string& str,
+                           uint64_t hash = 14695981039346656037ull) {
+  // include the terminator so that ("ab", "c") and ("a", "bc") differ
+  return hashBytes(str.c_str(), str.size() + 1, hash);
+}
+
+static std::string readShaderFile(const char* path) {
+  std::ifstream shaderFile;
   // ensure ifstream objects can throw exceptions (usually, ifstream fails
   // silently)
-  vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-  fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
-  std::stringstream vShaderStream, fShaderStream;
+  std::stringstream shaderStream;
   try {
-    vShaderFile.open(vertexPath);
+    shaderFile.open(path);
     // read file buffer contents into streams
-    vShaderStream << vShaderFile.rdbuf();
-    vShaderFile.close();
-    vertexCode = vShaderStream.str();
-
-  } catch (std::ifstream::failure e) {
+    shaderStream << shaderFile.rdbuf();
+    shaderFile.close();
+  } catch (std::ifstream::failure& e) {
     std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
-    std::cout << "Issue at: " << vertexPath << std::endl;
+    std::cout << "Issue at: " << path << std::endl;
   }
+  return shaderStream.str();
+}
 
-  try {
-    fShaderFile.open(fragmentPath);
-    // read file buffer contents into streams
-
-    fShaderStream << fShaderFile.rdbuf();
-    fShaderFile.close();
-    fragmentCode = fShaderStream.str();
-
-  } catch (std::ifstream::failure e) {
-    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
-    std::cout << "Issue at: " << fragmentPath << std::endl;
+static const char* getStageName(GLenum type) {
+  switch (type) {
+    case GL_VERTEX_SHADER:
+      return "VERTEX";
+    case GL_FRAGMENT_SHADER:
+      return "FRAGMENT";
+    case GL_COMPUTE_SHADER:
+      return "COMPUTE";
+    default:
+      return "UNKNOWN";
   }
-  const char* vShaderCode = vertexCode.c_str();
-  const char* fShaderCode = fragmentCode.c_str();
+}
 
-  // 2. compile shaders
-  unsigned int vertex, fragment;
+static unsigned int compileStage(GLenum type, const std::string& code) {
+  const char* shaderCode = code.c_str();
   int success;
   char infoLog[512];
 
-  vertex = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex, 1, &vShaderCode, NULL);
-  glCompileShader(vertex);
+  unsigned int shader = glCreateShader(type);
+  glShaderSource(shader, 1, &shaderCode, NULL);
+  glCompileShader(shader);
   // print compile errors
-  glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
   if (!success) {
-    glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-    std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n"
+    glGetShaderInfoLog(shader, 512, NULL, infoLog);
+    std::cout << "ERROR::SHADER::" << getStageName(type)
+              << "::COMPILATION_FAILED\n"
               << infoLog << std::endl;
   }
+  return shader;
+}
 
-  fragment = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment, 1, &fShaderCode, NULL);
-  glCompileShader(fragment);
+// inserts `defines` on the line after the `#version` directive
+static std::string injectDefines(const std::string& code,
+                                 const std::string& defines) {
+  if (defines.empty()) {
+    return code;
+  }
+  size_t versionPos = code.find("#version");
+  if (versionPos == std::string::npos) {
+    return defines + code;
+  }
+  size_t lineEnd = code.find('\n', versionPos);
+  if (lineEnd == std::string::npos) {
+    return code + "\n" + defines;
+  }
+  return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+}
 
-  glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-  if (!success) {
-    glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-    std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"
-              << infoLog << std::endl;
+// name used when reporting build results, kept on one line
+static std::string makeLabel(const std::string& paths,
+                             const std::string& defines) {
+  if (defines.empty()) {
+    return paths;
   }
+  std::string label = paths + " [" + defines + "]";
+  for (char& c : label) {
+    if (c == '\n') {
+      c = ' ';
+    }
+  }
+  return label;
+}
+
+Shader::Shader(const char* vertexPath,
+               const char* fragmentPath,
+               const std::string& defines) {
+  // 1. retrieve the source code from filePath
+  std::string vertexCode = injectDefines(readShaderFile(vertexPath), defines);
+  std::string fragmentCode =
+      injectDefines(readShaderFile(fragmentPath), defines);
+
+  // 2. load the cached program binary or compile shaders
+  build({{GL_VERTEX_SHADER, vertexCode}, {GL_FRAGMENT_SHADER, fragmentCode}},
+        makeLabel(std::string(vertexPath) + " + " + fragmentPath, defines));
+}
+
+Shader::Shader(const char* computePath, const std::string& defines) {
+  std::string computeCode = injectDefines(readShaderFile(computePath), defines);
+  build({{GL_COMPUTE_SHADER, computeCode}}, makeLabel(computePath, defines));
+}
+
+void Shader::build(const std::vector<ShaderStage>& stages,
+                   const std::string& label) {
+  auto start = std::chrono::steady_clock::now();
 
   ID = glCreateProgram();
-  glAttachShader(ID, vertex);
-  glAttachShader(ID, fragment);
+
+  // binaries are only valid for the exact driver that produced them
+  int binaryFormats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+  std::string cachePath;
+  if (binaryFormats > 0) {
+    uint64_t key = hashString("");
+    for (const ShaderStage& stage : stages) {
+      key = hashString(stage.code, key);
+    }
+    key = hashString((const char*)glGetString(GL_VENDOR), key);
+    key = hashString((const char*)glGetString(GL_RENDERER), key);
+    key = hashString((const char*)glGetString(GL_VERSION), key);
+
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.bin",
+                  (unsigned long long)key);
+    cachePath = std::string(SHADER_CACHE_DIR) + "/" + fileName;
+  }
+
+  bool cacheHit = !cachePath.empty() && loadProgramBinary(cachePath);
+  if (!cacheHit) {
+    // the driver rejected the binary (or there was none), start over
+    GlState::deleteProgram(ID);
+    ID = glCreateProgram();
+    compileAndLink(stages);
+    if (!cachePath.empty()) {
+      saveProgramBinary(cachePath);
+    }
+  }
+
+  reflectUniforms();
+
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "SHADER::CACHE::" << (cacheHit ? "HIT " : "MISS ") << label
+            << " (" << elapsed.count() << " ms)" << std::endl;
+}
+
+void Shader::compileAndLink(const std::vector<ShaderStage>& stages) {
+  int success;
+  char infoLog[512];
+
+  std::vector<unsigned int> shaders;
+  for (const ShaderStage& stage : stages) {
+    shaders.push_back(compileStage(stage.type, stage.code));
+    glAttachShader(ID, shaders.back());
+  }
+  // allow retrieving the binary for the program cache
+  glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   glLinkProgram(ID);
   // print linking errors if any
   glGetProgramiv(ID, GL_LINK_STATUS, &success);
@@ -78,36 +203,231 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
               << infoLog << std::endl;
   }
 
-  glDeleteShader(vertex);
-  glDeleteShader(fragment);
+  for (unsigned int shader : shaders) {
+    glDetachShader(ID, shader);
+    glDeleteShader(shader);
+  }
+}
+
+bool Shader::loadProgramBinary(const std::string& cachePath) {
+  std::ifstream file(cachePath, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  uint32_t header[3];  // magic, binary format, binary length
+  if (!file.read((char*)header, sizeof(header)) ||
+      header[0] != PROGRAM_BINARY_MAGIC) {
+    return false;
+  }
+
+  // a truncated or foreign file must not size the allocation, the rest of
+  // the file has to be exactly the binary
+  std::streampos begin = file.tellg();
+  file.seekg(0, std::ios::end);
+  std::streampos end = file.tellg();
+  file.seekg(begin);
+  if (begin < 0 || end < 0 || end - begin != (std::streamoff)header[2]) {
+    return false;
+  }
+
+  // formats this driver does not accept are never passed on
+  int formatCount = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  std::vector<int> formats(formatCount);
+  if (formatCount > 0) {
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+  }
+  if (std::find(formats.begin(), formats.end(), (int)header[1]) ==
+      formats.end()) {
+    return false;
+  }
+
+  std::vector<char> binary(header[2]);
+  if (!file.read(binary.data(), binary.size())) {
+    return false;
+  }
+
+  glProgramBinary(ID, header[1], binary.data(), (int)binary.size());
+  int success;
+  glGetProgramiv(ID, GL_LINK_STATUS, &success);
+  return success != 0;
+}
+
+void Shader::saveProgramBinary(const std::string& cachePath) const {
+  int success;
+  int length = 0;
+  glGetProgramiv(ID, GL_LINK_STATUS, &success);
+  glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (!success || length <= 0) {
+    return;
+  }
+
+  std::vector<char> binary(length);
+  GLenum format;
+  glGetProgramBinary(ID, length, &length, &format, binary.data());
+
+  mkdir(SHADER_CACHE_DIR, 0755);
+  std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    std::cout << "ERROR::SHADER::CACHE::WRITE_FAILED: " << cachePath
+              << std::endl;
+    return;
+  }
+  uint32_t header[3] = {PROGRAM_BINARY_MAGIC, format, (uint32_t)length};
+  file.write((const char*)header, sizeof(header));
+  file.write(binary.data(), length);
 }
 
 void Shader::use() {
-  glUseProgram(ID);
+  GlState::useProgram(ID);
+}
+
+int Shader::getUniformLocation(const std::string& name) const {
+  stats_.tableLookups++;
+  if (uniformTable_.empty()) {
+    stats_.tableMisses++;
+    return -1;
+  }
+
+  uint64_t hash = hashName(name.data(), name.size());
+  size_t mask = uniformTable_.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const UniformEntry& entry = uniformTable_[i];
+    if (entry.name.empty()) {
+      break;
+    }
+    if (entry.hash == hash && entry.name == name) {
+      return entry.location;
+    }
+  }
+  stats_.tableMisses++;
+  return -1;
 }
 
 void Shader::setBool(const std::string& name, bool value) const {
-  int boolLocation = glGetUniformLocation(ID, name.c_str());
-  glUniform1i(boolLocation, (int)value);
+  setBool(getUniformLocation(name), value);
 }
 
 void Shader::setInt(const std::string& name, int value) const {
-  glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+  setInt(getUniformLocation(name), value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const {
-  glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+  setFloat(getUniformLocation(name), value);
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& vec) const {
-  glUniform3f(glGetUniformLocation(ID, name.c_str()), vec.x, vec.y, vec.z);
+  setVec3(getUniformLocation(name), vec);
 }
 
 void Shader::setVec3(const std::string& name, float x, float y, float z) const {
-  glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+  glUniform3f(getUniformLocation(name), x, y, z);
 }
 
 void Shader::setMat4(const std::string& name, const glm::mat4& mat) const {
-  glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                     &mat[0][0]);
-}
\ No newline at end of file
+  setMat4(getUniformLocation(name), mat);
+}
+
+void Shader::setBool(int location, bool value) const {
+  glUniform1i(location, (int)value);
+}
+
+void Shader::setInt(int location, int value) const {
+  glUniform1i(location, value);
+}
+
+void Shader::setFloat(int location, float value) const {
+  glUniform1f(location, value);
+}
+
+void Shader::setVec3(int location, const glm::vec3& vec) const {
+  glUniform3f(location, vec.x, vec.y, vec.z);
+}
+
+void Shader::setMat4(int location, const glm::mat4& mat) const {
+  glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::reflectUniforms() {
+  int uniformCount = 0;
+  int maxNameLength = 0;
+  glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+  glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+  // collect (name, location) pairs first so the table can be sized once
+  std::vector<std::pair<std::string, int>> uniforms;
+  std::vector<char> nameBuffer(maxNameLength + 1);
+  for (int i = 0; i < uniformCount; i++) {
+    int length = 0;
+    int size = 0;
+    GLenum type;
+    glGetActiveUniform(ID, i, (int)nameBuffer.size(), &length, &size, &type,
+                       nameBuffer.data());
+    std::string name(nameBuffer.data(), length);
+
+    // arrays of basic types are reported once as `name[0]` with their size,
+    // register every element as well as the bare array name
+    if (size > 1 && name.size() > 3 &&
+        name.compare(name.size() - 3, 3, "[0]") == 0) {
+      std::string base = name.substr(0, name.size() - 3);
+      for (int element = 0; element < size; element++) {
+        std::string elementName = base + "[" + std::to_string(element) + "]";
+        stats_.locationQueries++;
+        int location = glGetUniformLocation(ID, elementName.c_str());
+        uniforms.emplace_back(elementName, location);
+        if (element == 0) {
+          uniforms.emplace_back(base, location);
+        }
+      }
+      continue;
+    }
+
+    stats_.locationQueries++;
+    int location = glGetUniformLocation(ID, name.c_str());
+    // uniforms inside of uniform blocks have no location
+    if (location >= 0) {
+      uniforms.emplace_back(name, location);
+    }
+  }
+
+  size_t capacity = 16;
+  while (capacity < uniforms.size() * 2) {
+    capacity *= 2;
+  }
+  uniformTable_.assign(capacity, UniformEntry{0, -1, std::string()});
+  for (auto& uniform : uniforms) {
+    insertUniform(uniform.first, uniform.second);
+  }
+
+
+  // texture units are fixed per slot, so materials only bind textures
+  for (int type = 0; type < TEXTURE_TYPE_COUNT; type++) {
+    int location = getUniformLocation(MATERIAL_SAMPLER_NAMES[type]);
+    handles_.materialSamplers[type] = location;
+    if (location >= 0) {
+      glProgramUniform1i(ID, location, type);
+    }
+  }
+  for (unsigned int i = 0; i < MAX_TEXTURE_ARRAYS; i++) {
+    int location =
+        getUniformLocation("textureArrays[" + std::to_string(i) + "]");
+    if (location >= 0) {
+      glProgramUniform1i(ID, location, TEXTURE_ARRAY_FIRST_UNIT + i);
+    }
+  }
+}
+
+void Shader::insertUniform(const std::string& name, int location) {
+  uint64_t hash = hashName(name.data(), name.size());
+  size_t mask = uniformTable_.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    UniformEntry& entry = uniformTable_[i];
+    if (entry.name.empty() || entry.name == name) {
+      entry.hash = hash;
+      entry.location = location;
+      entry.name = name;
+      return;
+    }
+  }
+}
@@ -3,27 +3,115 @@
 
 #include <glad/glad.h>
 
+#include <cstdint>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
+
+// directory (relative to the working directory) for cached program binaries
+const char* const SHADER_CACHE_DIR = "./shader_cache";
+
+/**
+ * @brief Counters for uniform location lookups.
+ *
+ * Locations are queried from the driver only while reflecting a freshly
+ * linked program, so `locationQueries` should stay at 0 in steady-state
+ * frames. Use `Shader::resetStats()` at the start of a frame to measure it.
+ */
+struct UniformStats {
+  // calls to glGetUniformLocation
+  unsigned int locationQueries = 0;
+  // name lookups served by the reflected uniform table
+  unsigned int tableLookups = 0;
+  // name lookups for uniforms that are not active in the program
+  unsigned int tableMisses = 0;
+};
+
+// material texture slots. The sampler of each slot reads from the texture
+// unit with the same index, set once when the program is linked.
+enum TextureType { TEXTURE_DIFFUSE, TEXTURE_SPECULAR, TEXTURE_TYPE_COUNT };
+
+// uniform buffer binding of the FrameData block
+constexpr unsigned int FRAME_UBO_BINDING = 0;
+
+// std140 mirror of the FrameData block, written once per frame
+struct GpuFrameData {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 viewPos;
+  float pad;
+};
+
+// `GL_TEXTURE_2D_ARRAY` pools sampled with `VARIANT_MATERIAL_ARRAYS`, pool i
+// is bound to texture unit `TEXTURE_ARRAY_FIRST_UNIT + i`
+constexpr unsigned int MAX_TEXTURE_ARRAYS = 8;
+constexpr unsigned int TEXTURE_ARRAY_FIRST_UNIT = TEXTURE_TYPE_COUNT;
+
+/**
+ * @brief Locations of uniforms the renderer sets from C++.
+ *
+ * Resolved once after linking, -1 if the uniform is not active in the
+ * program (setting a -1 location is a no-op in OpenGL).
+ */
+struct UniformHandles {
+  // sampler of each `TextureType`
+  int materialSamplers[TEXTURE_TYPE_COUNT] = {-1, -1};
+};
 
 class Shader {
  public:
   // the program ID (bound by OpenGL)
   unsigned int ID;
+  // pre-resolved uniform locations
+  UniformHandles handles_;
 
-  // constructor reads and builds the shader
-  Shader(const char* vertexPath, const char* fragmentPath);
+  /**
+   * @brief Reads and builds the shader
+   *
+   * The linked program binary is cached in `SHADER_CACHE_DIR`, keyed by the
+   * shader sources and the driver vendor/renderer/version. Later launches
+   * load the binary instead of compiling and fall back to compiling from
+   * source if the driver rejects it.
+   *
+   * @param vertexPath
+   * @param fragmentPath
+   * @param defines Lines (e.g. `#define TEXTURED\n`) inserted after the
+   * `#version` directive of both stages
+   */
+  Shader(const char* vertexPath,
+         const char* fragmentPath,
+         const std::string& defines = "");
 
   /**
-   * @brief Bind this shader to be the active shader in OpenGL
+   * @brief Reads and builds a compute shader, cached like the vertex and
+   * fragment constructor
+   *
+   * @param computePath
+   * @param defines Lines inserted after the `#version` directive
+   */
+  explicit Shader(const char* computePath, const std::string& defines = "");
+
+  /**
+   * @brief Bind this shader to be the active shader in OpenGL, through
+   * `GlState` so binding the current program is free
    *
-   * Use `use()` to activate the shader
    */
   void use();
 
+  /**
+   * @brief Get the location of an active uniform from the reflected table.
+   *
+   * Does not call into the driver. Array elements and struct members are
+   * looked up by their full name, e.g. `pointLights[3].position`.
+   *
+   * @param name Uniform variable name
+   * @return int location, -1 if the uniform is not active
+   */
+  int getUniformLocation(const std::string& name) const;
+
   /**
    * @brief Set a Bool uniform for this shader
    *
@@ -73,6 +161,91 @@ class Shader {
    * @param mat Uniform value
    */
   void setMat4(const std::string& name, const glm::mat4& mat) const;
+
+  // overloads taking a pre-resolved location (see `getUniformLocation()`)
+  void setBool(int location, bool value) const;
+  void setInt(int location, int value) const;
+  void setFloat(int location, float value) const;
+  void setVec3(int location, const glm::vec3& vec) const;
+  void setMat4(int location, const glm::mat4& mat) const;
+
+  /**
+   * @brief Get the uniform lookup counters shared by all shaders
+   *
+   * @return UniformStats&
+   */
+  static UniformStats& stats() { return stats_; }
+
+  /**
+   * @brief Reset the uniform lookup counters, e.g. at the start of a frame
+   *
+   */
+  static void resetStats() { stats_ = UniformStats(); }
+
+ private:
+  struct ShaderStage {
+    GLenum type;
+    std::string code;
+  };
+
+  struct UniformEntry {
+    uint64_t hash;
+    int location;
+    std::string name;  // empty if the slot is free
+  };
+
+  static UniformStats stats_;
+
+  // open addressing hash table (linear probing), size is a power of two
+  std::vector<UniformEntry> uniformTable_;
+
+  /**
+   * @brief Loads the program from the binary cache or compiles it from
+   * source, reports cache hit/miss and build time
+   *
+   * @param stages
+   * @param label Name used when reporting, e.g. the shader paths
+   */
+  void build(const std::vector<ShaderStage>& stages, const std::string& label);
+
+  /**
+   * @brief Compiles all stages and links them into `ID`
+   *
+   * @param stages
+   */
+  void compileAndLink(const std::vector<ShaderStage>& stages);
+
+  /**
+   * @brief Loads a cached program binary into `ID`
+   *
+   * @param cachePath
+   * @return true if the driver accepted the binary
+   * @return false if there is no cached binary, the file is malformed or
+   * the binary was rejected
+   */
+  bool loadProgramBinary(const std::string& cachePath);
+
+  /**
+   * @brief Writes the binary of the linked program `ID` to the cache
+   *
+   * @param cachePath
+   */
+  void saveProgramBinary(const std::string& cachePath) const;
+
+  /**
+   * @brief Enumerates all active uniforms of the linked program and stores
+   * their locations in `uniformTable_`, then resolves `handles_`.
+   *
+   */
+  void reflectUniforms();
+
+  /**
+   * @brief Inserts a uniform into `uniformTable_`
+   *
+   * @param name
+   * @param location
+   */
+  void insertUniform(const std::string& name, int location);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "shader_variants.hpp"
+
+#include "gl_state.hpp"
+
+static unsigned int specializeLightCount(unsigned int count) {
+  return count > MAX_SPECIALIZED_LIGHTS ? VARIANT_DYNAMIC_LIGHTS : count;
+}
+
+VariantKey makeLightVariantKey(unsigned int dirLights,
+                               unsigned int pointLights,
+                               unsigned int spotLights) {
+  return (specializeLightCount(dirLights) << 8) |
+         (specializeLightCount(pointLights) << 16) |
+         (specializeLightCount(spotLights) << 24);
+}
+
+ShaderVariants::ShaderVariants(const char* vertexPath,
+                               const char* fragmentPath)
+    : vertexPath_(vertexPath), fragmentPath_(fragmentPath) {
+  baseKey_ = 0;
+}
+
+Shader& ShaderVariants::get(VariantKey key) {
+  auto it = variants_.find(key);
+  if (it != variants_.end()) {
+    return *it->second;
+  }
+
+  std::unique_ptr<Shader> shader = std::make_unique<Shader>(
+      vertexPath_.c_str(), fragmentPath_.c_str(), makeDefines(key));
+  return *variants_.emplace(key, std::move(shader)).first->second;
+}
+
+Shader& ShaderVariants::use(VariantKey key) {
+  Shader& shader = get(key);
+  // redundant glUseProgram calls are filtered by `GlState`
+  shader.use();
+  return shader;
+}
+
+void ShaderVariants::deleteAll() {
+  for (auto& variant : variants_) {
+    GlState::deleteProgram(variant.second->ID);
+  }
+  variants_.clear();
+}
+
+std::string ShaderVariants::makeDefines(VariantKey key) {
+  std::string defines;
+  if (key & VARIANT_TEXTURED) {
+    defines += "#define TEXTURED\n";
+  }
+  if (key & VARIANT_SPECULAR) {
+    defines += "#define SPECULAR\n";
+  }
+  if (key & VARIANT_MATERIAL_ARRAYS) {
+    defines += "#define MATERIAL_ARRAYS\n";
+    defines += "#define MAX_TEXTURE_ARRAYS " +
+               std::to_string(MAX_TEXTURE_ARRAYS) + "\n";
+  }
+  if (key & VARIANT_PACKED_VERTICES) {
+    defines += "#define PACKED_VERTICES\n";
+  }
+  if (key & VARIANT_CLUSTERED) {
+    defines += "#define CLUSTERED\n";
+  }
+
+  const char* countNames[3] = {"NUM_DIR_LIGHTS", "NUM_POINT_LIGHTS",
+                               "NUM_SPOT_LIGHTS"};
+  for (int i = 0; i < 3; i++) {
+    unsigned int count = (key >> (8 * (i + 1))) & 0xff;
+    // dynamic counts fall back to the uniforms in the shader
+    if (count != VARIANT_DYNAMIC_LIGHTS) {
+      defines += "#define " + std::string(countNames[i]) + " " +
+                 std::to_string(count) + "\n";
+    }
+  }
+  return defines;
+}
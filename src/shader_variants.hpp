@@ -0,0 +1,136 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "shader.hpp"
+
+/**
+ * @brief Compact key that selects a shader permutation.
+ *
+ * bit 0      `TEXTURED`, sample the material textures (else flat color)
+ * bit 1      `SPECULAR`, evaluate specular highlights
+ * bit 2      `MATERIAL_ARRAYS`, material maps from texture arrays, selected
+ *            per instance through the material storage buffer
+ * bit 3      `PACKED_VERTICES`, decode `PackedVertex` attributes
+ * bit 4      `CLUSTERED`, clustered point/spot lights (else brute force)
+ * bits 8-15  `NUM_DIR_LIGHTS`
+ * bits 16-23 `NUM_POINT_LIGHTS`
+ * bits 24-31 `NUM_SPOT_LIGHTS`
+ */
+typedef uint32_t VariantKey;
+
+constexpr VariantKey VARIANT_TEXTURED = 1u << 0;
+constexpr VariantKey VARIANT_SPECULAR = 1u << 1;
+constexpr VariantKey VARIANT_MATERIAL_ARRAYS = 1u << 2;
+constexpr VariantKey VARIANT_PACKED_VERTICES = 1u << 3;
+// mask of the bits selected per mesh / material
+constexpr VariantKey VARIANT_MATERIAL_MASK = 0x0f;
+constexpr VariantKey VARIANT_CLUSTERED = 1u << 4;
+
+// light counts up to this value are compiled into the shader as constants
+constexpr unsigned int MAX_SPECIALIZED_LIGHTS = 8;
+// light count field value meaning "read the count from the uniform"
+constexpr unsigned int VARIANT_DYNAMIC_LIGHTS = 0xff;
+
+/**
+ * @brief Builds the light count part of a `VariantKey`.
+ *
+ * Counts above `MAX_SPECIALIZED_LIGHTS` share one variant that loops over
+ * the `num*Lights` uniforms, so the number of permutations stays bounded.
+ * Point and spot counts are upper bounds, the shader stops at the number of
+ * lights uploaded this frame. Pass the total counts, so culling lights
+ * does not select a new variant.
+ *
+ * @param dirLights
+ * @param pointLights
+ * @param spotLights
+ * @return VariantKey
+ */
+VariantKey makeLightVariantKey(unsigned int dirLights,
+                               unsigned int pointLights,
+                               unsigned int spotLights);
+
+/**
+ * @brief Lazily compiled and cached permutations of one vertex/fragment
+ * shader pair.
+ *
+ * Each permutation is compiled with `#define`s derived from its
+ * `VariantKey`, so material and light count branches are resolved at compile
+ * time instead of per fragment.
+ */
+class ShaderVariants {
+ public:
+  /**
+   * @brief Construct a new Shader Variants object. Nothing is compiled until
+   * a variant is requested.
+   *
+   * @param vertexPath
+   * @param fragmentPath
+   */
+  ShaderVariants(const char* vertexPath, const char* fragmentPath);
+
+  /**
+   * @brief Get the variant for `key`, compiling it on first request
+   *
+   * @param key
+   * @return Shader&
+   */
+  Shader& get(VariantKey key);
+
+  /**
+   * @brief Get the variant for `key` and bind it. Per-frame data comes from
+   * the FrameData uniform block, nothing is uploaded to the program.
+   *
+   * @param key
+   * @return Shader&
+   */
+  Shader& use(VariantKey key);
+
+  /**
+   * @brief Set the key bits shared by every draw this frame (lighting)
+   *
+   * @param key
+   */
+  void setBaseKey(VariantKey key) { baseKey_ = key & ~VARIANT_MATERIAL_MASK; }
+
+  /**
+   * @brief Get the key bits shared by every draw this frame
+   *
+   * @return VariantKey
+   */
+  VariantKey getBaseKey() const { return baseKey_; }
+
+  /**
+   * @brief Get the number of compiled variants
+   *
+   * @return size_t
+   */
+  size_t getVariantCount() const { return variants_.size(); }
+
+  /**
+   * @brief Deletes all compiled programs
+   *
+   */
+  void deleteAll();
+
+ private:
+  std::string vertexPath_;
+  std::string fragmentPath_;
+  std::unordered_map<VariantKey, std::unique_ptr<Shader>> variants_;
+
+  VariantKey baseKey_;
+
+  /**
+   * @brief Get the `#define` block for a key
+   *
+   * @param key
+   * @return std::string
+   */
+  static std::string makeDefines(VariantKey key);
+};
+
+#endif
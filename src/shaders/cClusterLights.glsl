@@ -0,0 +1,101 @@
+#version 460 core
+
+// one invocation per cluster, see CLUSTER_WORK_GROUP_SIZE in lightclusters.cpp
+layout (local_size_x = 64) in;
+
+// injected by LightClusters:
+// MAX_LIGHTS_PER_CLUSTER  size of each cluster's fixed light list
+
+#define SPOT_LIGHT_INDEX_BIT 0x80000000u
+
+// std430 layout, mirrored by GpuPointLight/GpuSpotLight in lightmanager.hpp
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+    float radius;
+};
+
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+    float radius;
+};
+
+layout (std430, binding = 1) readonly buffer PointLights {
+    int numPointLights;
+    PointLight pointLights[];
+};
+
+layout (std430, binding = 2) readonly buffer SpotLights {
+    int numSpotLights;
+    SpotLight spotLights[];
+};
+
+layout (std430, binding = 3) buffer LightGrid {
+    uvec4 clusterGrid;    // x, y, z cluster counts
+    vec4 clusterScreen;   // viewport width, height, slice scale, slice bias
+    uvec2 lightGrid[];    // offset, count per cluster
+};
+
+layout (std430, binding = 4) writeonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+layout (std430, binding = 5) readonly buffer ClusterBounds {
+    vec4 clusterBounds[];  // view space min, max per cluster
+};
+
+// std140 layout, mirrored by GpuFrameData in shader.hpp
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+bool sphereIntersectsBounds(vec3 center, float radius, vec3 boundsMin, vec3 boundsMax) {
+    vec3 delta = clamp(center, boundsMin, boundsMax) - center;
+    return dot(delta, delta) <= radius * radius;
+}
+
+void main() {
+    uint cluster = gl_GlobalInvocationID.x;
+    if (cluster >= clusterGrid.x * clusterGrid.y * clusterGrid.z) {
+        return;
+    }
+
+    vec3 boundsMin = clusterBounds[2 * cluster].xyz;
+    vec3 boundsMax = clusterBounds[2 * cluster + 1].xyz;
+
+    uint offset = cluster * MAX_LIGHTS_PER_CLUSTER;
+    uint count = 0;
+
+    for (int i = 0; i < numPointLights && count < MAX_LIGHTS_PER_CLUSTER; i++) {
+        vec3 center = vec3(view * vec4(pointLights[i].position, 1.0));
+        if (sphereIntersectsBounds(center, pointLights[i].radius, boundsMin, boundsMax)) {
+            lightIndices[offset + count] = uint(i);
+            count++;
+        }
+    }
+    for (int i = 0; i < numSpotLights && count < MAX_LIGHTS_PER_CLUSTER; i++) {
+        vec3 center = vec3(view * vec4(spotLights[i].position, 1.0));
+        if (sphereIntersectsBounds(center, spotLights[i].radius, boundsMin, boundsMax)) {
+            lightIndices[offset + count] = uint(i) | SPOT_LIGHT_INDEX_BIT;
+            count++;
+        }
+    }
+
+    lightGrid[cluster] = uvec2(offset, count);
+}
@@ -1,6 +1,8 @@
 #version 460 core
 out vec4 FragColor;
 
+in vec3 Color;
+
 void main() {    
-    FragColor = vec4(1.0, 1.0, 1.0, 1.0);
+    FragColor = vec4(Color, 1.0);
 }
\ No newline at end of file
@@ -5,63 +5,146 @@ out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
-
-#define MAX_LIGHTS 16
+in float ViewDepth;
+in vec3 Color;
+flat in uint MaterialIndex;
+
+// Permutation defines, injected by ShaderVariants:
+// TEXTURED          sample material textures, else use the instance color
+// SPECULAR          evaluate specular highlights
+// MATERIAL_ARRAYS   read the maps of the instance's material from texture
+//                   arrays, ignores TEXTURED and SPECULAR
+// NUM_DIR_LIGHTS    compile time light counts, fall back to the uniforms
+// NUM_POINT_LIGHTS  when not defined. Point and spot counts are upper
+// NUM_SPOT_LIGHTS   bounds, only the culled lights in the buffers are used
+// CLUSTERED         only evaluate the point/spot lights of the fragment's
+//                   cluster (see LightClusters), else loop over all lights
+#ifndef NUM_DIR_LIGHTS
+#define NUM_DIR_LIGHTS numDirLights
+#endif
+#ifndef NUM_POINT_LIGHTS
+#define NUM_POINT_LIGHTS numPointLights
+#endif
+#ifndef NUM_SPOT_LIGHTS
+#define NUM_SPOT_LIGHTS numSpotLights
+#endif
 
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
-    bool useColor;
-    vec3 color;
 };
 
+// std430 layout, mirrored by GpuDirLight/GpuPointLight/GpuSpotLight in
+// lightmanager.hpp: every vec3 is followed by a float in the same 16 bytes
 struct DirLight {
     vec3 direction;
-
+    float pad0;
     vec3 ambient;
+    float pad1;
     vec3 diffuse;
+    float pad2;
     vec3 specular;
+    float pad3;
 };
 
 struct PointLight {
     vec3 position;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
+    float radius;
 };
 
 struct SpotLight {
     vec3 position;
+    float constant;
     vec3 direction;
-
+    float linear;
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
-    vec3 specular;
-
     float cutOff;
+    vec3 specular;
     float outerCutOff;
+    float radius;
+};
 
-    float constant;
-    float linear;
-    float quadratic;
+// shared by all programs, bound to *_LIGHTS_SSBO_BINDING by the LightManager
+layout (std430, binding = 0) readonly buffer DirLights {
+    int numDirLights;
+    DirLight dirLights[];
+};
+
+layout (std430, binding = 1) readonly buffer PointLights {
+    int numPointLights;
+    PointLight pointLights[];
+};
+
+layout (std430, binding = 2) readonly buffer SpotLights {
+    int numSpotLights;
+    SpotLight spotLights[];
 };
 
-uniform int numDirLights;
-uniform DirLight dirLights[MAX_LIGHTS];
+#ifdef CLUSTERED
+#define SPOT_LIGHT_INDEX_BIT 0x80000000u
 
-uniform int numPointLights;
-uniform PointLight pointLights[MAX_LIGHTS];
+layout (std430, binding = 3) readonly buffer LightGrid {
+    uvec4 clusterGrid;    // x, y, z cluster counts
+    vec4 clusterScreen;   // viewport width, height, slice scale, slice bias
+    uvec2 lightGrid[];    // offset, count per cluster
+};
 
-uniform int numSpotLights;
-uniform SpotLight spotLights[MAX_LIGHTS];
+layout (std430, binding = 4) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+uint GetClusterIndex() {
+    uvec2 tile = uvec2(gl_FragCoord.xy / clusterScreen.xy * vec2(clusterGrid.xy));
+    tile = min(tile, clusterGrid.xy - 1);
+    // exponential depth slices
+    int slice = int(floor(log(ViewDepth) * clusterScreen.z - clusterScreen.w));
+    uint z = uint(clamp(slice, 0, int(clusterGrid.z) - 1));
+    return tile.x + clusterGrid.x * (tile.y + clusterGrid.y * z);
+}
+#endif
 
 uniform Material material;
-uniform vec3 viewPos;
+
+#ifdef MATERIAL_ARRAYS
+// std430 layout, mirrored by GpuMaterial in scene/instance_batcher.hpp
+#define MATERIAL_DIFFUSE_MAP 1u
+#define MATERIAL_SPECULAR_MAP 2u
+struct MaterialData {
+    ivec4 maps;  // diffuse array and layer, specular array and layer
+    uint flags;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout (std430, binding = 8) readonly buffer Materials {
+    int numMaterials;
+    // the elements start at offset 16 (STORAGE_BUFFER_HEADER_SIZE)
+    int materialsPad0;
+    int materialsPad1;
+    int materialsPad2;
+    MaterialData materials[];
+};
+
+// one pool per texture size and format, see TextureArrays. All instances of
+// a draw share their mesh and therefore their material, so the index is
+// dynamically uniform.
+uniform sampler2DArray textureArrays[MAX_TEXTURE_ARRAYS];
+#endif
+// std140 layout, mirrored by GpuFrameData in shader.hpp
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 materialDiff, vec3 materialSpec);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 materialDiff, vec3 materialSpec);
@@ -70,30 +153,62 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
 void main() {
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 materialDiff, materialSpec;
-
-    if (material.useColor) {
-        materialDiff = material.color;
-        materialSpec = material.color;
+    vec3 materialDiff, materialSpec = vec3(0.0);
+
+#if defined(MATERIAL_ARRAYS)
+    MaterialData data = materials[MaterialIndex];
+    if ((data.flags & MATERIAL_DIFFUSE_MAP) != 0u) {
+        materialDiff = texture(textureArrays[data.maps.x], vec3(TexCoords, data.maps.y)).rgb;
+        if ((data.flags & MATERIAL_SPECULAR_MAP) != 0u) {
+            materialSpec = texture(textureArrays[data.maps.z], vec3(TexCoords, data.maps.w)).rgb;
+        }
     } else {
-        materialDiff = texture(material.texture_diffuse1, TexCoords).rgb;
-        materialSpec = texture(material.texture_specular1, TexCoords).rgb;
+        materialDiff = Color;
+        materialSpec = Color;
     }
+#elif defined(TEXTURED)
+    materialDiff = texture(material.texture_diffuse1, TexCoords).rgb;
+#ifdef SPECULAR
+    materialSpec = texture(material.texture_specular1, TexCoords).rgb;
+#endif
+#else
+    materialDiff = Color;
+    materialSpec = Color;
+#endif
 
     vec3 texColor = vec3(0);
 
     // Apply directional lights
-    for (int i = 0; i < numDirLights; i++) {
+    for (int i = 0; i < NUM_DIR_LIGHTS; i++) {
         texColor += CalcDirLight(dirLights[i], norm, viewDir, materialDiff, materialSpec);
     }
+#ifdef CLUSTERED
+    // Apply point and spot lights of this cluster
+    uvec2 cluster = lightGrid[GetClusterIndex()];
+    for (uint i = 0; i < cluster.y; i++) {
+        uint index = lightIndices[cluster.x + i];
+        if ((index & SPOT_LIGHT_INDEX_BIT) != 0) {
+            texColor += CalcSpotLight(spotLights[index & ~SPOT_LIGHT_INDEX_BIT], norm, FragPos, viewDir, materialDiff, materialSpec);
+        } else {
+            texColor += CalcPointLight(pointLights[index], norm, FragPos, viewDir, materialDiff, materialSpec);
+        }
+    }
+#else
     // Apply point lights
-    for (int i = 0; i < numPointLights; i++) {
+    for (int i = 0; i < NUM_POINT_LIGHTS; i++) {
+        if (i >= numPointLights) {
+            break;
+        }
         texColor += CalcPointLight(pointLights[i], norm, FragPos, viewDir, materialDiff, materialSpec);
     }
     // Apply spot lights 
-    for (int i = 0; i < numSpotLights; i++) {
+    for (int i = 0; i < NUM_SPOT_LIGHTS; i++) {
+        if (i >= numSpotLights) {
+            break;
+        }
         texColor += CalcSpotLight(spotLights[i], norm, FragPos, viewDir, materialDiff, materialSpec);
     }
+#endif
 
     FragColor = vec4(min(texColor, vec3(1.0)), 1.0);
 
@@ -105,14 +220,20 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 materialDiff,
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
 
+#ifdef SPECULAR
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 256);
+#endif
 
     // combine results
     vec3 ambient  = light.ambient  * materialDiff;
     vec3 diffuse  = light.diffuse  * diff * materialDiff;
-    vec3 specular = light.specular * diff * spec * materialSpec;  
+#ifdef SPECULAR
+    vec3 specular = light.specular * diff * spec * materialSpec;
+#else
+    vec3 specular = vec3(0.0);
+#endif
 
     return ambient + diffuse + specular;
 }
@@ -123,9 +244,11 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
 
+#ifdef SPECULAR
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 256);
+#endif
 
     // attenuation
     float distance = length(light.position - fragPos);
@@ -134,7 +257,11 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
     // combine results
     vec3 ambient  = light.ambient  * materialDiff;
     vec3 diffuse  = light.diffuse  * diff * materialDiff;
+#ifdef SPECULAR
     vec3 specular = light.specular * diff * spec * materialSpec;
+#else
+    vec3 specular = vec3(0.0);
+#endif
 
     ambient  *= attenuation;
     diffuse  *= attenuation;
@@ -149,9 +276,11 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
 
+#ifdef SPECULAR
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 256);
+#endif
 
     // attenuation
     float distance = length(light.position - fragPos);
@@ -165,7 +294,11 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
     // combine results
     vec3 ambient  = light.ambient  * materialDiff;
     vec3 diffuse  = light.diffuse  * diff * materialDiff;
+#ifdef SPECULAR
     vec3 specular = light.specular * diff * spec * materialSpec;
+#else
+    vec3 specular = vec3(0.0);
+#endif
 
     ambient  *= attenuation * intensity;
     diffuse  *= attenuation * intensity;
@@ -1,11 +1,21 @@
 #version 460 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+// per instance
+layout (location = 2) in vec4 aPositionScale;
+layout (location = 3) in vec3 aColor;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+out vec3 Color;
+
+// std140 layout, mirrored by GpuFrameData in shader.hpp
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    vec3 worldPos = aPositionScale.xyz + aPos * aPositionScale.w;
+    Color = aColor;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
@@ -1,20 +1,70 @@
 #version 460 core
+#ifdef PACKED_VERTICES
+// PackedVertex of scene/vertex_format.hpp: positions normalized to the mesh
+// bounds (undone by the model matrix), octahedral encoded normals
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aNormal;
+#else
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+#endif
 layout (location = 2) in vec2 aTexCoords;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out float ViewDepth;
+out vec3 Color;
+flat out uint MaterialIndex;
+
+// std430 layout, mirrored by GpuInstance in scene/instance_batcher.hpp
+struct Instance {
+    mat4 model;
+    mat3 normalMatrix;
+    vec3 color;
+    uint material;
+};
+
+layout (std430, binding = 6) readonly buffer Instances {
+    int numInstances;
+    Instance instances[];
+};
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// std140 layout, mirrored by GpuFrameData in shader.hpp
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+#ifdef PACKED_VERTICES
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+#endif
 
 void main() {
+    // the batch's first instance is passed as base instance of the draw,
+    // by the draw call or by its indirect command
+    Instance instance = instances[gl_BaseInstance + gl_InstanceID];
+    mat4 model = instance.model;
+
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+#ifdef PACKED_VERTICES
+    Normal = instance.normalMatrix * decodeOctahedral(aNormal);
+#else
+    Normal = instance.normalMatrix * aNormal;
+#endif
     TexCoords = aTexCoords;
+    Color = instance.color;
+    MaterialIndex = instance.material;
 
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec4 viewPos = view * model * vec4(aPos, 1.0);
+    ViewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
 }
\ No newline at end of file
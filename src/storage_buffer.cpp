@@ -0,0 +1,132 @@
+#include "storage_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "gl_state.hpp"
+
+// initial GPU capacity in elements
+static const size_t MIN_CAPACITY = 16;
+
+/**
+ * @brief Creates an immutable buffer that can be updated with
+ * `glNamedBufferSubData`
+ *
+ * @param size in bytes
+ * @return unsigned int
+ */
+static unsigned int createStorage(size_t size) {
+  unsigned int buffer;
+  glCreateBuffers(1, &buffer);
+  glNamedBufferStorage(buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  return buffer;
+}
+
+StorageBuffer::StorageBuffer(unsigned int binding, size_t elementSize)
+    : binding_(binding), elementSize_(elementSize) {
+  count_ = 0;
+  gpuCapacity_ = MIN_CAPACITY;
+  dirtyBegin_ = 0;
+  dirtyEnd_ = 0;
+  countDirty_ = false;
+  data_.assign(STORAGE_BUFFER_HEADER_SIZE, 0);
+
+  buffer_ =
+      createStorage(STORAGE_BUFFER_HEADER_SIZE + gpuCapacity_ * elementSize_);
+  glNamedBufferSubData(buffer_, 0, STORAGE_BUFFER_HEADER_SIZE, data_.data());
+
+  GlState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, binding_, buffer_);
+}
+
+unsigned int StorageBuffer::push(const void* element) {
+  unsigned int index = count_++;
+  // std::vector grows geometrically, appending stays amortized O(1)
+  data_.resize(STORAGE_BUFFER_HEADER_SIZE + count_ * elementSize_);
+  std::memcpy(&data_[STORAGE_BUFFER_HEADER_SIZE + index * elementSize_],
+              element, elementSize_);
+  markDirty(index);
+  countDirty_ = true;
+  return index;
+}
+
+bool StorageBuffer::write(unsigned int index, const void* element) {
+  if (index >= count_) {
+    return false;
+  }
+  char* dst = &data_[STORAGE_BUFFER_HEADER_SIZE + index * elementSize_];
+  if (std::memcmp(dst, element, elementSize_) == 0) {
+    return false;
+  }
+  std::memcpy(dst, element, elementSize_);
+  markDirty(index);
+  return true;
+}
+
+void StorageBuffer::resize(unsigned int count) {
+  if (count == count_) {
+    return;
+  }
+  unsigned int oldCount = count_;
+  count_ = count;
+  data_.resize(STORAGE_BUFFER_HEADER_SIZE + count_ * elementSize_, 0);
+  if (count_ > oldCount) {
+    markDirty(oldCount);
+    markDirty(count_ - 1);
+  } else {
+    // drop dirty elements that no longer exist
+    dirtyEnd_ = std::min(dirtyEnd_, (size_t)count_);
+  }
+  countDirty_ = true;
+}
+
+void StorageBuffer::clear() {
+  if (count_ == 0) {
+    return;
+  }
+  count_ = 0;
+  data_.resize(STORAGE_BUFFER_HEADER_SIZE);
+  dirtyBegin_ = dirtyEnd_ = 0;
+  countDirty_ = true;
+}
+
+void StorageBuffer::upload() {
+  if (!countDirty_ && dirtyBegin_ >= dirtyEnd_) {
+    return;
+  }
+  std::memcpy(data_.data(), &count_, sizeof(count_));
+
+  if (count_ > gpuCapacity_) {
+    // grow geometrically and upload everything into a new allocation,
+    // immutable storage can't be resized in place
+    gpuCapacity_ = std::max((size_t)count_, gpuCapacity_ * 2);
+    GlState::deleteBuffer(buffer_);
+    buffer_ =
+        createStorage(STORAGE_BUFFER_HEADER_SIZE + gpuCapacity_ * elementSize_);
+    glNamedBufferSubData(buffer_, 0, data_.size(), data_.data());
+    GlState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, binding_, buffer_);
+  } else {
+    if (countDirty_) {
+      glNamedBufferSubData(buffer_, 0, STORAGE_BUFFER_HEADER_SIZE,
+                           data_.data());
+    }
+    if (dirtyBegin_ < dirtyEnd_) {
+      size_t offset = STORAGE_BUFFER_HEADER_SIZE + dirtyBegin_ * elementSize_;
+      glNamedBufferSubData(buffer_, offset,
+                           (dirtyEnd_ - dirtyBegin_) * elementSize_,
+                           &data_[offset]);
+    }
+  }
+
+  dirtyBegin_ = dirtyEnd_ = 0;
+  countDirty_ = false;
+}
+
+void StorageBuffer::markDirty(size_t index) {
+  if (dirtyBegin_ >= dirtyEnd_) {
+    dirtyBegin_ = index;
+    dirtyEnd_ = index + 1;
+    return;
+  }
+  dirtyBegin_ = std::min(dirtyBegin_, index);
+  dirtyEnd_ = std::max(dirtyEnd_, index + 1);
+}
@@ -0,0 +1,106 @@
+#ifndef STORAGE_BUFFER_H
+#define STORAGE_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// bytes before the first element, the element count is stored at offset 0
+constexpr size_t STORAGE_BUFFER_HEADER_SIZE = 16;
+
+/**
+ * @brief Growable shader storage buffer holding an element count followed by
+ * an array of fixed size elements.
+ *
+ * Matches a std430 block of the form
+ *
+ * `buffer Name { int count; Element elements[]; };`
+ *
+ * for elements with 16 byte alignment. Elements are staged on the CPU and
+ * only the changed range is uploaded. The GPU allocation grows
+ * geometrically, so appending is amortized O(1).
+ */
+class StorageBuffer {
+ public:
+  /**
+   * @brief Construct a new Storage Buffer object and bind it to `binding`
+   *
+   * @param binding GL_SHADER_STORAGE_BUFFER binding point
+   * @param elementSize size of one element in bytes
+   */
+  StorageBuffer(unsigned int binding, size_t elementSize);
+
+  /**
+   * @brief Appends an element
+   *
+   * @param element pointer to `elementSize` bytes
+   * @return unsigned int index of the new element
+   */
+  unsigned int push(const void* element);
+
+  /**
+   * @brief Overwrites an element. The element is only marked for upload if
+   * its bytes changed.
+   *
+   * @param index
+   * @param element pointer to `elementSize` bytes
+   * @return true if the element changed,
+   * @return false if it was unchanged or `index` is out of range
+   */
+  bool write(unsigned int index, const void* element);
+
+  /**
+   * @brief Sets the element count. New elements are zero initialized.
+   *
+   * @param count
+   */
+  void resize(unsigned int count);
+
+  /**
+   * @brief Removes all elements, keeping the allocations
+   *
+   */
+  void clear();
+
+  /**
+   * @brief Uploads the changes since the last upload, reallocating the GPU
+   * buffer if it is too small
+   *
+   */
+  void upload();
+
+  /**
+   * @brief Get the element count
+   *
+   * @return unsigned int
+   */
+  unsigned int size() const { return count_; }
+
+  /**
+   * @brief Get the GL buffer name, replaced when the buffer grows
+   *
+   * @return unsigned int
+   */
+  unsigned int getBuffer() const { return buffer_; }
+
+ private:
+  unsigned int buffer_;
+  unsigned int binding_;
+  size_t elementSize_;
+
+  // header + elements, as laid out on the GPU
+  std::vector<char> data_;
+  unsigned int count_;
+  // element capacity of the GPU allocation
+  size_t gpuCapacity_;
+
+  // range of elements changed since the last upload
+  size_t dirtyBegin_;
+  size_t dirtyEnd_;
+  bool countDirty_;
+
+  void markDirty(size_t index);
+};
+
+#endif
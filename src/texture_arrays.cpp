@@ -0,0 +1,115 @@
+#include "texture_arrays.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "gl_state.hpp"
+
+/**
+ * @brief Maps the unsized formats used by `loadTextureFromFile` to the sized
+ * formats immutable storage needs
+ *
+ * @param format
+ * @return GLenum
+ */
+static GLenum toSizedFormat(GLenum format) {
+  switch (format) {
+    case GL_RED:
+      return GL_R8;
+    case GL_RG:
+      return GL_RG8;
+    case GL_RGB:
+      return GL_RGB8;
+    case GL_RGBA:
+      return GL_RGBA8;
+  }
+  return format;
+}
+
+TextureArrays::~TextureArrays() {
+  for (const Pool& pool : pools_) {
+    GlState::deleteTexture(pool.texture);
+  }
+}
+
+TextureLayer TextureArrays::add(unsigned int texture) {
+  auto it = layers_.find(texture);
+  if (it != layers_.end()) {
+    return it->second;
+  }
+
+  int width = 0;
+  int height = 0;
+  int format = 0;
+  glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+  glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT,
+                               &format);
+  GLenum sizedFormat = toSizedFormat(format);
+
+  unsigned int index = 0;
+  while (index < pools_.size() &&
+         (pools_[index].width != width || pools_[index].height != height ||
+          pools_[index].format != sizedFormat)) {
+    index++;
+  }
+  if (index == pools_.size()) {
+    if (pools_.size() == MAX_TEXTURE_ARRAYS) {
+      std::cout << "ERROR::TEXTURE_ARRAYS::TOO_MANY_POOLS: " << width << "x"
+                << height << std::endl;
+      TextureLayer none = {-1, -1};
+      layers_[texture] = none;
+      return none;
+    }
+    int levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+      levels++;
+    }
+    pools_.push_back({0, width, height, sizedFormat, levels, 0, 0});
+  }
+
+  Pool& pool = pools_[index];
+  if (pool.layerCount == pool.layerCapacity) {
+    grow(pool, std::max(TEXTURE_ARRAY_MIN_LAYERS, pool.layerCapacity * 2));
+  }
+
+  TextureLayer layer = {(int)index, (int)pool.layerCount++};
+  for (int level = 0; level < pool.levels; level++) {
+    glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0, pool.texture,
+                       GL_TEXTURE_2D_ARRAY, level, 0, 0, layer.layer,
+                       std::max(width >> level, 1),
+                       std::max(height >> level, 1), 1);
+  }
+  layers_[texture] = layer;
+  return layer;
+}
+
+void TextureArrays::bind() const {
+  for (unsigned int i = 0; i < pools_.size(); i++) {
+    GlState::bindTexture(TEXTURE_ARRAY_FIRST_UNIT + i, pools_[i].texture,
+                         GL_TEXTURE_2D_ARRAY);
+  }
+}
+
+void TextureArrays::grow(Pool& pool, unsigned int capacity) {
+  unsigned int texture;
+  glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+  glTextureStorage3D(texture, pool.levels, pool.format, pool.width,
+                     pool.height, capacity);
+  glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  if (pool.texture != 0) {
+    for (int level = 0; level < pool.levels; level++) {
+      glCopyImageSubData(pool.texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                         texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                         std::max(pool.width >> level, 1),
+                         std::max(pool.height >> level, 1), pool.layerCount);
+    }
+    GlState::deleteTexture(pool.texture);
+  }
+  pool.texture = texture;
+  pool.layerCapacity = capacity;
+}
@@ -0,0 +1,89 @@
+#ifndef TEXTURE_ARRAYS_H
+#define TEXTURE_ARRAYS_H
+
+#include <glad/glad.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "shader.hpp"
+
+// layers allocated for a new pool, pools grow by doubling
+constexpr unsigned int TEXTURE_ARRAY_MIN_LAYERS = 4;
+
+// location of a texture in `TextureArrays`, `array` is -1 if it could not
+// be pooled
+struct TextureLayer {
+  int array;
+  int layer;
+};
+
+/**
+ * @brief Pools of `GL_TEXTURE_2D_ARRAY`s, one per size and format.
+ *
+ * 2D textures are copied into a layer of the matching pool (all mip levels,
+ * on the GPU), so draws using different textures of the same size and
+ * format can share one set of texture bindings. At most
+ * `MAX_TEXTURE_ARRAYS` pools exist, matching the sampler array of the
+ * `MATERIAL_ARRAYS` shader variant.
+ */
+class TextureArrays {
+ public:
+  TextureArrays() = default;
+  /**
+   * @brief Deletes the array textures, the GL context must still be current
+   *
+   */
+  ~TextureArrays();
+
+  TextureArrays(const TextureArrays&) = delete;
+  TextureArrays& operator=(const TextureArrays&) = delete;
+
+  /**
+   * @brief Get the layer holding `texture`, copying it into a pool on first
+   * use. The texture must have a full mip chain.
+   *
+   * @param texture `GL_TEXTURE_2D` name
+   * @return TextureLayer
+   */
+  TextureLayer add(unsigned int texture);
+
+  /**
+   * @brief Binds pool i to texture unit `TEXTURE_ARRAY_FIRST_UNIT + i`
+   *
+   */
+  void bind() const;
+
+  /**
+   * @brief Get the number of pools
+   *
+   * @return unsigned int
+   */
+  unsigned int size() const { return pools_.size(); }
+
+ private:
+  struct Pool {
+    unsigned int texture;
+    int width;
+    int height;
+    GLenum format;  // sized internal format
+    int levels;
+    unsigned int layerCount;
+    unsigned int layerCapacity;
+  };
+
+  std::vector<Pool> pools_;
+  // layer of every texture added so far, by 2D texture name
+  std::unordered_map<unsigned int, TextureLayer> layers_;
+
+  /**
+   * @brief Reallocates `pool` with room for `capacity` layers, keeping its
+   * contents
+   *
+   * @param pool
+   * @param capacity
+   */
+  static void grow(Pool& pool, unsigned int capacity);
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -16,31 +17,49 @@ unsigned int loadTextureFromFile(const char* path,
   filename = directory + '/' + filename;
 
   unsigned int textureID;
-  glGenTextures(1, &textureID);
+  glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
 
   int width, height, nrComponents;
   unsigned char* data =
       stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
   if (data) {
     GLenum format;
+    GLenum internalFormat;
     if (nrComponents == 1) {
       format = GL_RED;
+      internalFormat = GL_R8;
+    } else if (nrComponents == 2) {
+      format = GL_RG;
+      internalFormat = GL_RG8;
     } else if (nrComponents == 3) {
       format = GL_RGB;
+      internalFormat = GL_RGB8;
     } else if (nrComponents == 4) {
       format = GL_RGBA;
+      internalFormat = GL_RGBA8;
+    } else {
+      // no storage is allocated, the texture stays incomplete
+      std::cout << "ERROR::TEXTURE::UNSUPPORTED_CHANNELS: " << nrComponents
+                << " at path: " << path << std::endl;
+      stbi_image_free(data);
+      return textureID;
     }
 
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                 GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    // immutable storage with the full mip chain
+    int levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+      levels++;
+    }
+    glTextureStorage2D(textureID, levels, internalFormat, width, height);
+    glTextureSubImage2D(textureID, 0, 0, 0, width, height, format,
+                        GL_UNSIGNED_BYTE, data);
+    glGenerateTextureMipmap(textureID);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                    GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER,
+                        GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     stbi_image_free(data);
   } else {
@@ -66,6 +66,9 @@ void Window::updateDeltaTime() {
 
     std::string newTitle =
         std::string(title_) + " - FPS: " + std::to_string(fps_);
+    if (!status_.empty()) {
+      newTitle += " - " + status_;
+    }
     glfwSetWindowTitle(window_, newTitle.c_str());
   }
 }
@@ -94,6 +97,14 @@ void Window::processInput() {
   }
 }
 
+bool Window::keyPressed(int key) {
+  bool down = glfwGetKey(window_, key) == GLFW_PRESS;
+  bool& wasDown = keyDown_[key];
+  bool pressed = down && !wasDown;
+  wasDown = down;
+  return pressed;
+}
+
 void Window::framebufferSizeCallback(GLFWwindow* window,
                                      int width,
                                      int height) {
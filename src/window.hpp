@@ -5,6 +5,8 @@
 #include <GLFW/glfw3.h>
 // clang-format on
 #include <iostream>
+#include <string>
+#include <unordered_map>
 
 #include "camera.hpp"
 
@@ -61,6 +63,23 @@ class Window {
    */
   void processInput();
 
+  /**
+   * @brief Check if a key went down since the last call for that key. Used
+   * for toggles that should only trigger once per key press.
+   *
+   * @param key GLFW key code
+   * @return true
+   * @return false
+   */
+  bool keyPressed(int key);
+
+  /**
+   * @brief Set per-frame statistics shown in the title next to the FPS
+   *
+   * @param status
+   */
+  void setStatus(const std::string& status) { status_ = status; }
+
  private:
   bool initFailed_;
 
@@ -77,6 +96,12 @@ class Window {
   float fpsTimer_ = 0.0f;
   int fps_ = 0;
 
+  // key state seen by the last `keyPressed()` call
+  std::unordered_map<int, bool> keyDown_;
+
+  // shown in the title after the FPS
+  std::string status_;
+
   const char* title_;
   unsigned int width_;
   unsigned int height_;
@@ -0,0 +1,75 @@
+#include "worker_pool.hpp"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned int workerCount) {
+  job_ = nullptr;
+  partCount_ = 0;
+  generation_ = 0;
+  pending_ = 0;
+  stop_ = false;
+  for (unsigned int i = 0; i < workerCount; i++) {
+    workers_.emplace_back(&WorkerPool::work, this, i + 1);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkerPool::run(unsigned int partCount,
+                     const std::function<void(unsigned int)>& job) {
+  partCount = std::min(partCount, getThreadCount());
+  if (partCount == 0) {
+    return;
+  }
+  if (partCount > 1) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = &job;
+      partCount_ = partCount;
+      pending_ = partCount - 1;
+      generation_++;
+    }
+    start_.notify_all();
+  }
+
+  job(0);
+
+  if (partCount > 1) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    job_ = nullptr;
+  }
+}
+
+void WorkerPool::work(unsigned int part) {
+  unsigned int generation = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    start_.wait(lock, [&] { return stop_ || generation_ != generation; });
+    if (stop_) {
+      return;
+    }
+    generation = generation_;
+    // jobs split into fewer parts leave the last workers idle
+    if (part >= partCount_) {
+      continue;
+    }
+
+    const std::function<void(unsigned int)>* job = job_;
+    lock.unlock();
+    (*job)(part);
+    lock.lock();
+    if (--pending_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed set of threads that run the parts of one job at a time.
+ *
+ * The threads are started once and sleep between jobs, so splitting a
+ * frame's work costs a wake up instead of creating and joining threads.
+ * The calling thread runs part 0 itself.
+ */
+class WorkerPool {
+ public:
+  /**
+   * @brief Construct a new Worker Pool object and start its threads
+   *
+   * @param workerCount threads besides the caller, may be 0
+   */
+  explicit WorkerPool(unsigned int workerCount);
+
+  /**
+   * @brief Stops and joins the threads
+   *
+   */
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /**
+   * @brief Runs `job(part)` for every part in [0, partCount) and returns
+   * when all of them finished
+   *
+   * @param partCount clamped to `getThreadCount()`
+   * @param job called concurrently, once per part
+   */
+  void run(unsigned int partCount,
+           const std::function<void(unsigned int)>& job);
+
+  /**
+   * @brief Get the number of threads a job can run on, including the caller
+   *
+   * @return unsigned int
+   */
+  unsigned int getThreadCount() const { return workers_.size() + 1; }
+
+ private:
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  // signaled when a job is posted or the pool stops
+  std::condition_variable start_;
+  // signaled when the last worker part of a job finished
+  std::condition_variable done_;
+
+  // current job, only valid while `run()` waits
+  const std::function<void(unsigned int)>* job_;
+  unsigned int partCount_;
+  // incremented per job, workers compare it to the last job they saw
+  unsigned int generation_;
+  // worker parts of the current job that have not finished
+  unsigned int pending_;
+  bool stop_;
+
+  /**
+   * @brief Thread loop of the worker running part `part` of every job
+   *
+   * @param part
+   */
+  void work(unsigned int part);
+};
+
+#endif